@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "arena.h"
+#include "utils.h"
+
+static ARENA_SLAB* create_slab(size_t size) {
+    ARENA_SLAB* slab = (ARENA_SLAB*)malloc(sizeof(ARENA_SLAB) + size);
+    slab->next = NULL;
+    slab->size = size;
+    slab->used = 0;
+    return slab;
+}
+
+void create_arena(ARENA* arena, size_t slab_size) {
+    arena->slab_size = slab_size;
+    arena->first = create_slab(slab_size);
+    arena->current = arena->first;
+}
+
+// offset into the slab where an allocation starting after used would begin
+static size_t aligned_offset(ARENA_SLAB* slab) {
+    uintptr_t address = (uintptr_t)(slab->data + slab->used);
+    uintptr_t aligned = (address + ARENA_ALIGNMENT - 1) & ~(uintptr_t)(ARENA_ALIGNMENT - 1);
+    return slab->used + (aligned - address);
+}
+
+void* arena_alloc(ARENA* arena, size_t size) {
+    // slabs kept from before the last reset are reused before new ones are made
+    while (aligned_offset(arena->current) + size > arena->current->size) {
+        if (arena->current->next == NULL) {
+            DBG_PRINT("arena: adding slab for %d bytes\n", (int)size);
+            size_t slab_size = size + ARENA_ALIGNMENT;
+            arena->current->next = create_slab(slab_size > arena->slab_size ? slab_size : arena->slab_size);
+        }
+        arena->current = arena->current->next;
+    }
+
+    size_t offset = aligned_offset(arena->current);
+    arena->current->used = offset + size;
+    return arena->current->data + offset;
+}
+
+void arena_reset(ARENA* arena) {
+    for (ARENA_SLAB* slab = arena->first; slab != NULL; slab = slab->next)
+        slab->used = 0;
+    arena->current = arena->first;
+}
+
+void delete_arena(ARENA* arena) {
+    ARENA_SLAB* slab = arena->first;
+    while (slab != NULL) {
+        ARENA_SLAB* next = slab->next;
+        free(slab);
+        slab = next;
+    }
+    arena->first = NULL;
+    arena->current = NULL;
+}
@@ -0,0 +1,30 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_SLAB_SIZE 4096
+#define ARENA_ALIGNMENT 16
+
+typedef struct ARENA_SLAB {
+    struct ARENA_SLAB* next;
+    size_t size;
+    size_t used;
+    char data[];
+} ARENA_SLAB;
+
+// bump allocator over a chain of slabs. allocations are never freed one by one, arena_reset
+// hands everything back at once and keeps the slabs, so a reset arena allocates from the heap
+// again only when it is asked for more than it held before
+typedef struct {
+    ARENA_SLAB* first;
+    ARENA_SLAB* current;
+    size_t slab_size;
+} ARENA;
+
+void create_arena(ARENA* arena, size_t slab_size);
+void* arena_alloc(ARENA* arena, size_t size);
+void arena_reset(ARENA* arena);
+void delete_arena(ARENA* arena);
+
+#endif  // ARENA_H
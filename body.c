@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "body.h"
+#include "utils.h"
+
+static void grow_dense(BODY_STORE* store) {
+    store->capacity *= 2;
+    store->shapes = (POLYGON**)realloc(store->shapes, store->capacity * sizeof(POLYGON*));
+    store->positions = (VECTOR*)realloc(store->positions, store->capacity * sizeof(VECTOR));
+    store->velocities = (VECTOR*)realloc(store->velocities, store->capacity * sizeof(VECTOR));
+    store->aabbs = (AABB*)realloc(store->aabbs, store->capacity * sizeof(AABB));
+    store->dense_slots = (int*)realloc(store->dense_slots, store->capacity * sizeof(int));
+}
+
+void create_body_store(BODY_STORE* store, int capacity) {
+    store->shapes = (POLYGON**)malloc(capacity * sizeof(POLYGON*));
+    store->positions = (VECTOR*)malloc(capacity * sizeof(VECTOR));
+    store->velocities = (VECTOR*)malloc(capacity * sizeof(VECTOR));
+    store->aabbs = (AABB*)malloc(capacity * sizeof(AABB));
+    store->dense_slots = (int*)malloc(capacity * sizeof(int));
+    store->count = 0;
+    store->capacity = capacity;
+    store->layout_version = 0;
+
+    store->slot_indices = (int*)malloc(capacity * sizeof(int));
+    store->generations = (int*)calloc(capacity, sizeof(int));
+    store->slots_count = 0;
+    store->slots_capacity = capacity;
+    store->free_slot = -1;
+}
+
+static int acquire_slot(BODY_STORE* store) {
+    if (store->free_slot != -1) {
+        int slot = store->free_slot;
+        store->free_slot = store->slot_indices[slot];
+        return slot;
+    }
+
+    if (store->slots_count == store->slots_capacity) {
+        store->slots_capacity *= 2;
+        store->slot_indices = (int*)realloc(store->slot_indices, store->slots_capacity * sizeof(int));
+        store->generations = (int*)realloc(store->generations, store->slots_capacity * sizeof(int));
+        memset(store->generations + store->slots_count, 0, (store->slots_capacity - store->slots_count) * sizeof(int));
+    }
+    return store->slots_count++;
+}
+
+// the shape is referenced, not copied, so it has to outlive the body
+BODY_HANDLE body_store_add(BODY_STORE* store, POLYGON* shape, VECTOR position, VECTOR velocity) {
+    BODY_HANDLE handle;
+
+    if (store->count == store->capacity)
+        grow_dense(store);
+
+    int index = store->count++;
+    handle.slot = acquire_slot(store);
+    handle.generation = store->generations[handle.slot];
+    store->slot_indices[handle.slot] = index;
+    store->dense_slots[index] = handle.slot;
+
+    store->shapes[index] = shape;
+    store->positions[index] = position;
+    store->velocities[index] = velocity;
+    store->aabbs[index].min.x = shape->aabb.min.x + position.x;
+    store->aabbs[index].min.y = shape->aabb.min.y + position.y;
+    store->aabbs[index].max.x = shape->aabb.max.x + position.x;
+    store->aabbs[index].max.y = shape->aabb.max.y + position.y;
+    store->layout_version++;
+    return handle;
+}
+
+void body_store_remove(BODY_STORE* store, BODY_HANDLE handle) {
+    int index = body_index(store, handle);
+    if (index < 0)
+        return;
+
+    store->count--;
+    if (index != store->count) {
+        int last = store->count;
+        store->shapes[index] = store->shapes[last];
+        store->positions[index] = store->positions[last];
+        store->velocities[index] = store->velocities[last];
+        store->aabbs[index] = store->aabbs[last];
+        store->dense_slots[index] = store->dense_slots[last];
+        store->slot_indices[store->dense_slots[index]] = index;
+    }
+
+    store->layout_version++;
+    store->generations[handle.slot]++;
+    store->slot_indices[handle.slot] = store->free_slot;
+    store->free_slot = handle.slot;
+}
+
+void body_store_clear(BODY_STORE* store) {
+    // every handle handed out so far goes stale
+    for (int slot = 0; slot < store->slots_count; slot++)
+        store->generations[slot]++;
+    store->count = 0;
+    store->layout_version++;
+    store->slots_count = 0;
+    store->free_slot = -1;
+}
+
+// dense index of the body, or -1 if it has been removed
+int body_index(BODY_STORE* store, BODY_HANDLE handle) {
+    if (handle.slot < 0 || handle.slot >= store->slots_count || store->generations[handle.slot] != handle.generation)
+        return -1;
+    return store->slot_indices[handle.slot];
+}
+
+BODY_HANDLE body_handle(BODY_STORE* store, int index) {
+    BODY_HANDLE handle;
+    handle.slot = store->dense_slots[index];
+    handle.generation = store->generations[handle.slot];
+    return handle;
+}
+
+int same_body(BODY_HANDLE handle1, BODY_HANDLE handle2) {
+    return handle1.slot == handle2.slot && handle1.generation == handle2.generation;
+}
+
+void translate_body(BODY_STORE* store, int index, int dx, int dy) {
+    store->positions[index].x += dx;
+    store->positions[index].y += dy;
+    store->aabbs[index].min.x += dx;
+    store->aabbs[index].min.y += dy;
+    store->aabbs[index].max.x += dx;
+    store->aabbs[index].max.y += dy;
+}
+
+void print_body_store_details(BODY_STORE* store) {
+    for (int i = 0; i < store->count; i++) {
+        printf("body %d slot %d: %d vertices at (%d, %d), aabb (%d, %d) (%d, %d), velocity (%d, %d)\n",
+            i, store->dense_slots[i], (int)store->shapes[i]->vertices_idx, store->positions[i].x, store->positions[i].y,
+            store->aabbs[i].min.x, store->aabbs[i].min.y, store->aabbs[i].max.x, store->aabbs[i].max.y,
+            store->velocities[i].x, store->velocities[i].y);
+    }
+}
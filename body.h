@@ -0,0 +1,45 @@
+#ifndef BODY_H
+#define BODY_H
+
+#include "vector.h"
+
+#define BODY_STORE_INITIAL_CAPACITY 32
+
+// stays valid for the life of the body, unlike its dense index which changes whenever
+// another body is removed. a stale handle fails the generation check
+typedef struct {
+    int slot;
+    int generation;
+} BODY_HANDLE;
+
+// structure of arrays over all live bodies. the dense arrays stay packed, removing a body
+// moves the last one into its place. a body is a shared shape placed at a position, so
+// moving it never touches vertices
+typedef struct {
+    POLYGON** shapes; // local space, shared between bodies and never modified
+    VECTOR* positions;
+    VECTOR* velocities;
+    AABB* aabbs; // shape aabb moved to the position
+    int* dense_slots; // dense index to handle slot
+    int count;
+    int capacity;
+    int layout_version; // bumped whenever a dense index changes body or shape, moving a body keeps it
+
+    int* slot_indices; // handle slot to dense index, or the next free slot once released
+    int* generations;
+    int slots_count;
+    int slots_capacity;
+    int free_slot;
+} BODY_STORE;
+
+void create_body_store(BODY_STORE* store, int capacity);
+BODY_HANDLE body_store_add(BODY_STORE* store, POLYGON* shape, VECTOR position, VECTOR velocity);
+void body_store_remove(BODY_STORE* store, BODY_HANDLE handle);
+void body_store_clear(BODY_STORE* store);
+int body_index(BODY_STORE* store, BODY_HANDLE handle);
+BODY_HANDLE body_handle(BODY_STORE* store, int index);
+int same_body(BODY_HANDLE handle1, BODY_HANDLE handle2);
+void translate_body(BODY_STORE* store, int index, int dx, int dy);
+void print_body_store_details(BODY_STORE* store);
+
+#endif  // BODY_H
@@ -0,0 +1,659 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "broadphase.h"
+#include "utils.h"
+
+static void add_pair(PAIR_LIST* pair_list, BODY_HANDLE body1, BODY_HANDLE body2, int offset_x, int offset_y) {
+    // the outgrown block stays in the arena until the next reset
+    if (pair_list->count == pair_list->capacity) {
+        COLLISION_PAIR* pairs = pair_list->pairs;
+        pair_list->capacity = (pair_list->capacity > 0) ? pair_list->capacity * 2 : BROADPHASE_INITIAL_CAPACITY;
+        pair_list->pairs = (COLLISION_PAIR*)arena_alloc(pair_list->arena, pair_list->capacity * sizeof(COLLISION_PAIR));
+        if (pair_list->count > 0)
+            memcpy(pair_list->pairs, pairs, pair_list->count * sizeof(COLLISION_PAIR));
+    }
+    pair_list->pairs[pair_list->count].body1 = body1;
+    pair_list->pairs[pair_list->count].body2 = body2;
+    pair_list->pairs[pair_list->count].offset.x = offset_x;
+    pair_list->pairs[pair_list->count].offset.y = offset_y;
+    pair_list->count++;
+}
+
+static AABB* body_aabb(BODY_STORE* store, BODY_HANDLE body) {
+    return &store->aabbs[body_index(store, body)];
+}
+
+static int aabb_overlap(AABB* aabb1, AABB* aabb2) {
+    return aabb1->min.x <= aabb2->max.x && aabb2->min.x <= aabb1->max.x
+        && aabb1->min.y <= aabb2->max.y && aabb2->min.y <= aabb1->max.y;
+}
+
+// overlap of two intervals on a circle of length period. bodies are much smaller than the
+// world, so shifting the second interval by at most one period is enough
+static int wrapped_overlap(int min1, int max1, int min2, int max2, int period, int* p_offset) {
+    int shifts[3] = { 0, period, -period };
+    for (int i = 0; i < 3; i++) {
+        if (min1 <= max2 + shifts[i] && min2 + shifts[i] <= max1) {
+            *p_offset = shifts[i];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void update_endpoints(SWEEP_AND_PRUNE* sap, SAP_ENTRY* entry) {
+    AABB* aabb = body_aabb(sap->store, entry->body);
+    entry->min_x = aabb->min.x;
+    entry->max_x = aabb->max.x;
+    entry->min_y = aabb->min.y;
+    entry->max_y = aabb->max.y;
+}
+
+void create_sweep_and_prune(SWEEP_AND_PRUNE* sap, BODY_STORE* store, int capacity, int world_width, int world_height) {
+    sap->store = store;
+    sap->entries = (SAP_ENTRY*)malloc(capacity * sizeof(SAP_ENTRY));
+    sap->count = 0;
+    sap->capacity = capacity;
+    sap->world_width = world_width;
+    sap->world_height = world_height;
+}
+
+void sap_add_body(SWEEP_AND_PRUNE* sap, BODY_HANDLE body) {
+    if (sap->count == sap->capacity) {
+        sap->capacity *= 2;
+        sap->entries = (SAP_ENTRY*)realloc(sap->entries, sap->capacity * sizeof(SAP_ENTRY));
+    }
+
+    // appended at the end, the next sap_update moves it into place
+    SAP_ENTRY* entry = &sap->entries[sap->count++];
+    entry->body = body;
+    update_endpoints(sap, entry);
+}
+
+void sap_remove_body(SWEEP_AND_PRUNE* sap, BODY_HANDLE body) {
+    for (int i = 0; i < sap->count; i++) {
+        if (same_body(sap->entries[i].body, body)) {
+            // shift down rather than swap so the rest stays sorted
+            memmove(&sap->entries[i], &sap->entries[i + 1], (sap->count - i - 1) * sizeof(SAP_ENTRY));
+            sap->count--;
+            return;
+        }
+    }
+}
+
+void sap_clear(SWEEP_AND_PRUNE* sap) {
+    sap->count = 0;
+}
+
+void sap_update(SWEEP_AND_PRUNE* sap) {
+    for (int i = 0; i < sap->count; i++)
+        update_endpoints(sap, &sap->entries[i]);
+
+    for (int i = 1; i < sap->count; i++) {
+        SAP_ENTRY entry = sap->entries[i];
+        int j = i - 1;
+        while (j >= 0 && sap->entries[j].min_x > entry.min_x) {
+            sap->entries[j + 1] = sap->entries[j];
+            j--;
+        }
+        sap->entries[j + 1] = entry;
+    }
+}
+
+void sweep_and_prune(SWEEP_AND_PRUNE* sap, PAIR_LIST* pair_list) {
+    int offset_y;
+
+    for (int i = 0; i < sap->count - 1; i++) {
+        SAP_ENTRY* entry_i = &sap->entries[i];
+
+        for (int j = i + 1; j < sap->count; j++) {
+            SAP_ENTRY* entry_j = &sap->entries[j];
+            if (entry_j->min_x > entry_i->max_x)
+                break;
+            if (!wrapped_overlap(entry_i->min_y, entry_i->max_y, entry_j->min_y, entry_j->max_y, sap->world_height, &offset_y))
+                continue;
+
+            add_pair(pair_list, entry_i->body, entry_j->body, 0, offset_y);
+        }
+    }
+
+    if (sap->count == 0)
+        return;
+
+    // entries reaching past the right seam get a ghost one world width to the left, which
+    // only has to be swept against the sorted prefix at the left edge
+    for (int i = 0; i < sap->count; i++) {
+        SAP_ENTRY* entry_i = &sap->entries[i];
+        int ghost_min_x = entry_i->min_x - sap->world_width;
+        int ghost_max_x = entry_i->max_x - sap->world_width;
+        if (ghost_max_x < sap->entries[0].min_x)
+            continue;
+
+        for (int j = 0; j < sap->count && sap->entries[j].min_x <= ghost_max_x; j++) {
+            SAP_ENTRY* entry_j = &sap->entries[j];
+            if (j == i || entry_j->max_x < ghost_min_x)
+                continue;
+            if (!wrapped_overlap(entry_i->min_y, entry_i->max_y, entry_j->min_y, entry_j->max_y, sap->world_height, &offset_y))
+                continue;
+
+            add_pair(pair_list, entry_i->body, entry_j->body, sap->world_width, offset_y);
+        }
+    }
+}
+
+void create_spatial_grid(SPATIAL_GRID* grid, BODY_STORE* store, int capacity, int world_width, int world_height) {
+    grid->store = store;
+    grid->world_width = world_width;
+    grid->world_height = world_height;
+    // cells tile the world exactly so a body wrapping across an edge lands in the right cells
+    grid->cells_x = (world_width / GRID_CELL_SIZE > 0) ? world_width / GRID_CELL_SIZE : 1;
+    grid->cells_y = (world_height / GRID_CELL_SIZE > 0) ? world_height / GRID_CELL_SIZE : 1;
+    grid->bodies = (BODY_HANDLE*)malloc(capacity * sizeof(BODY_HANDLE));
+    grid->count = 0;
+    grid->capacity = capacity;
+    grid->cell_start = (int*)malloc((grid->cells_x * grid->cells_y + 1) * sizeof(int));
+    grid->cell_cursor = (int*)malloc(grid->cells_x * grid->cells_y * sizeof(int));
+    grid->cell_entries = NULL;
+    grid->last_tested = (int*)malloc(capacity * sizeof(int));
+}
+
+void grid_add_body(SPATIAL_GRID* grid, BODY_HANDLE body) {
+    if (grid->count == grid->capacity) {
+        grid->capacity *= 2;
+        grid->bodies = (BODY_HANDLE*)realloc(grid->bodies, grid->capacity * sizeof(BODY_HANDLE));
+        grid->last_tested = (int*)realloc(grid->last_tested, grid->capacity * sizeof(int));
+    }
+    grid->bodies[grid->count++] = body;
+}
+
+void grid_remove_body(SPATIAL_GRID* grid, BODY_HANDLE body) {
+    for (int i = 0; i < grid->count; i++) {
+        if (same_body(grid->bodies[i], body)) {
+            grid->bodies[i] = grid->bodies[--grid->count];
+            return;
+        }
+    }
+}
+
+void grid_clear(SPATIAL_GRID* grid) {
+    grid->count = 0;
+}
+
+static int floor_div(int value, int divisor) {
+    int quotient = value / divisor;
+    return (value % divisor != 0 && (value < 0) != (divisor < 0)) ? quotient - 1 : quotient;
+}
+
+static int wrap_cell(int cell, int cells) {
+    return ((cell % cells) + cells) % cells;
+}
+
+// unwrapped cell range covered by the aabb, capped at one full lap of the world
+static void cell_range(SPATIAL_GRID* grid, AABB* aabb, int* p_x0, int* p_x1, int* p_y0, int* p_y1) {
+    *p_x0 = floor_div(aabb->min.x * grid->cells_x, grid->world_width);
+    *p_x1 = floor_div(aabb->max.x * grid->cells_x, grid->world_width);
+    *p_y0 = floor_div(aabb->min.y * grid->cells_y, grid->world_height);
+    *p_y1 = floor_div(aabb->max.y * grid->cells_y, grid->world_height);
+    if (*p_x1 - *p_x0 >= grid->cells_x)
+        *p_x1 = *p_x0 + grid->cells_x - 1;
+    if (*p_y1 - *p_y0 >= grid->cells_y)
+        *p_y1 = *p_y0 + grid->cells_y - 1;
+}
+
+static void build_cells(SPATIAL_GRID* grid, ARENA* arena) {
+    int num_cells = grid->cells_x * grid->cells_y;
+    int num_entries = 0;
+    int x0, x1, y0, y1;
+
+    memset(grid->cell_start, 0, (num_cells + 1) * sizeof(int));
+    for (int i = 0; i < grid->count; i++) {
+        cell_range(grid, body_aabb(grid->store, grid->bodies[i]), &x0, &x1, &y0, &y1);
+        for (int y = y0; y <= y1; y++) {
+            for (int x = x0; x <= x1; x++)
+                grid->cell_start[wrap_cell(y, grid->cells_y) * grid->cells_x + wrap_cell(x, grid->cells_x) + 1]++;
+        }
+        num_entries += (x1 - x0 + 1) * (y1 - y0 + 1);
+    }
+
+    grid->cell_entries = (int*)arena_alloc(arena, num_entries * sizeof(int));
+
+    for (int cell = 0; cell < num_cells; cell++)
+        grid->cell_start[cell + 1] += grid->cell_start[cell];
+
+    memcpy(grid->cell_cursor, grid->cell_start, num_cells * sizeof(int));
+    for (int i = 0; i < grid->count; i++) {
+        cell_range(grid, body_aabb(grid->store, grid->bodies[i]), &x0, &x1, &y0, &y1);
+        for (int y = y0; y <= y1; y++) {
+            for (int x = x0; x <= x1; x++)
+                grid->cell_entries[grid->cell_cursor[wrap_cell(y, grid->cells_y) * grid->cells_x + wrap_cell(x, grid->cells_x)]++] = i;
+        }
+    }
+}
+
+void grid_find_pairs(SPATIAL_GRID* grid, PAIR_LIST* pair_list) {
+    int x0, x1, y0, y1;
+    int offset_x, offset_y;
+
+    build_cells(grid, pair_list->arena);
+    for (int i = 0; i < grid->count; i++)
+        grid->last_tested[i] = -1;
+
+    // walk each body's cells and pair it with higher indexed cell mates, last_tested
+    // skips a mate already seen in an earlier shared cell
+    for (int i = 0; i < grid->count; i++) {
+        AABB* aabb = body_aabb(grid->store, grid->bodies[i]);
+        cell_range(grid, aabb, &x0, &x1, &y0, &y1);
+
+        for (int y = y0; y <= y1; y++) {
+            for (int x = x0; x <= x1; x++) {
+                int cell = wrap_cell(y, grid->cells_y) * grid->cells_x + wrap_cell(x, grid->cells_x);
+                for (int k = grid->cell_start[cell]; k < grid->cell_start[cell + 1]; k++) {
+                    int j = grid->cell_entries[k];
+                    if (j <= i || grid->last_tested[j] == i)
+                        continue;
+                    grid->last_tested[j] = i;
+
+                    // cells wrap, so mates can sit across a seam from each other
+                    AABB* other = body_aabb(grid->store, grid->bodies[j]);
+                    if (wrapped_overlap(aabb->min.x, aabb->max.x, other->min.x, other->max.x, grid->world_width, &offset_x)
+                        && wrapped_overlap(aabb->min.y, aabb->max.y, other->min.y, other->max.y, grid->world_height, &offset_y))
+                        add_pair(pair_list, grid->bodies[i], grid->bodies[j], offset_x, offset_y);
+                }
+            }
+        }
+    }
+}
+
+static AABB aabb_union(AABB* aabb1, AABB* aabb2) {
+    AABB result;
+    result.min.x = (aabb1->min.x < aabb2->min.x) ? aabb1->min.x : aabb2->min.x;
+    result.min.y = (aabb1->min.y < aabb2->min.y) ? aabb1->min.y : aabb2->min.y;
+    result.max.x = (aabb1->max.x > aabb2->max.x) ? aabb1->max.x : aabb2->max.x;
+    result.max.y = (aabb1->max.y > aabb2->max.y) ? aabb1->max.y : aabb2->max.y;
+    return result;
+}
+
+static int aabb_contains(AABB* outer, AABB* inner) {
+    return outer->min.x <= inner->min.x && outer->min.y <= inner->min.y
+        && inner->max.x <= outer->max.x && inner->max.y <= outer->max.y;
+}
+
+// perimeter stands in for surface area when picking where to insert in 2d
+static int aabb_perimeter(AABB* aabb) {
+    return 2 * ((aabb->max.x - aabb->min.x) + (aabb->max.y - aabb->min.y));
+}
+
+static AABB fatten(AABB_TREE* tree, AABB* aabb) {
+    AABB result;
+    result.min.x = aabb->min.x - tree->margin;
+    result.min.y = aabb->min.y - tree->margin;
+    result.max.x = aabb->max.x + tree->margin;
+    result.max.y = aabb->max.y + tree->margin;
+    return result;
+}
+
+static void link_free_nodes(AABB_TREE* tree, int start) {
+    for (int i = start; i < tree->nodes_capacity - 1; i++) {
+        tree->nodes[i].parent = i + 1;
+        tree->nodes[i].height = -1;
+    }
+    tree->nodes[tree->nodes_capacity - 1].parent = AABB_TREE_NULL;
+    tree->nodes[tree->nodes_capacity - 1].height = -1;
+    tree->free_list = start;
+}
+
+static int allocate_node(AABB_TREE* tree) {
+    if (tree->free_list == AABB_TREE_NULL) {
+        int old_capacity = tree->nodes_capacity;
+        tree->nodes_capacity *= 2;
+        tree->nodes = (AABB_TREE_NODE*)realloc(tree->nodes, tree->nodes_capacity * sizeof(AABB_TREE_NODE));
+        link_free_nodes(tree, old_capacity);
+    }
+
+    int index = tree->free_list;
+    tree->free_list = tree->nodes[index].parent;
+    tree->nodes[index].parent = AABB_TREE_NULL;
+    tree->nodes[index].child1 = AABB_TREE_NULL;
+    tree->nodes[index].child2 = AABB_TREE_NULL;
+    tree->nodes[index].height = 0;
+    tree->nodes[index].proxy = AABB_TREE_NULL;
+    return index;
+}
+
+static void free_node(AABB_TREE* tree, int index) {
+    tree->nodes[index].parent = tree->free_list;
+    tree->nodes[index].height = -1;
+    tree->free_list = index;
+}
+
+static void refit(AABB_TREE* tree, int index) {
+    AABB_TREE_NODE* node = &tree->nodes[index];
+    AABB_TREE_NODE* child1 = &tree->nodes[node->child1];
+    AABB_TREE_NODE* child2 = &tree->nodes[node->child2];
+    node->aabb = aabb_union(&child1->aabb, &child2->aabb);
+    node->height = 1 + ((child1->height > child2->height) ? child1->height : child2->height);
+}
+
+static void replace_child(AABB_TREE* tree, int parent, int old_child, int new_child) {
+    if (parent == AABB_TREE_NULL)
+        tree->root = new_child;
+    else if (tree->nodes[parent].child1 == old_child)
+        tree->nodes[parent].child1 = new_child;
+    else
+        tree->nodes[parent].child2 = new_child;
+}
+
+// lift index_a's taller child index_up into its place. index_up keeps its taller child
+// and hands the shorter one down to index_a
+static int rotate(AABB_TREE* tree, int index_a, int index_up) {
+    AABB_TREE_NODE* nodes = tree->nodes;
+    int index_f = nodes[index_up].child1;
+    int index_g = nodes[index_up].child2;
+    int keep = (nodes[index_f].height > nodes[index_g].height) ? index_f : index_g;
+    int move = (keep == index_f) ? index_g : index_f;
+
+    nodes[index_up].parent = nodes[index_a].parent;
+    replace_child(tree, nodes[index_up].parent, index_a, index_up);
+    nodes[index_up].child1 = index_a;
+    nodes[index_up].child2 = keep;
+    nodes[index_a].parent = index_up;
+
+    if (nodes[index_a].child1 == index_up)
+        nodes[index_a].child1 = move;
+    else
+        nodes[index_a].child2 = move;
+    nodes[move].parent = index_a;
+
+    refit(tree, index_a);
+    refit(tree, index_up);
+    return index_up;
+}
+
+static int balance(AABB_TREE* tree, int index) {
+    AABB_TREE_NODE* node = &tree->nodes[index];
+    if (node->height < 2)
+        return index;
+
+    int difference = tree->nodes[node->child2].height - tree->nodes[node->child1].height;
+    if (difference > 1)
+        return rotate(tree, index, node->child2);
+    if (difference < -1)
+        return rotate(tree, index, node->child1);
+    return index;
+}
+
+static void refit_ancestors(AABB_TREE* tree, int index) {
+    while (index != AABB_TREE_NULL) {
+        index = balance(tree, index);
+        refit(tree, index);
+        index = tree->nodes[index].parent;
+    }
+}
+
+static void insert_leaf(AABB_TREE* tree, int leaf) {
+    if (tree->root == AABB_TREE_NULL) {
+        tree->root = leaf;
+        tree->nodes[leaf].parent = AABB_TREE_NULL;
+        return;
+    }
+
+    // descend towards the sibling that grows the total perimeter the least
+    AABB leaf_aabb = tree->nodes[leaf].aabb;
+    int index = tree->root;
+    while (tree->nodes[index].height > 0) {
+        AABB_TREE_NODE* node = &tree->nodes[index];
+        AABB combined = aabb_union(&node->aabb, &leaf_aabb);
+        int combined_perimeter = aabb_perimeter(&combined);
+        int cost = 2 * combined_perimeter;
+        int inheritance = 2 * (combined_perimeter - aabb_perimeter(&node->aabb));
+
+        int child_cost[2];
+        int children[2] = { node->child1, node->child2 };
+        for (int i = 0; i < 2; i++) {
+            AABB_TREE_NODE* child = &tree->nodes[children[i]];
+            AABB child_combined = aabb_union(&child->aabb, &leaf_aabb);
+            child_cost[i] = aabb_perimeter(&child_combined) + inheritance;
+            if (child->height > 0)
+                child_cost[i] -= aabb_perimeter(&child->aabb);
+        }
+
+        if (cost < child_cost[0] && cost < child_cost[1])
+            break;
+        index = (child_cost[0] < child_cost[1]) ? children[0] : children[1];
+    }
+
+    int sibling = index;
+    int old_parent = tree->nodes[sibling].parent;
+    int new_parent = allocate_node(tree);
+    tree->nodes[new_parent].parent = old_parent;
+    tree->nodes[new_parent].child1 = sibling;
+    tree->nodes[new_parent].child2 = leaf;
+    replace_child(tree, old_parent, sibling, new_parent);
+    tree->nodes[sibling].parent = new_parent;
+    tree->nodes[leaf].parent = new_parent;
+
+    refit_ancestors(tree, new_parent);
+}
+
+static void remove_leaf(AABB_TREE* tree, int leaf) {
+    if (leaf == tree->root) {
+        tree->root = AABB_TREE_NULL;
+        return;
+    }
+
+    int parent = tree->nodes[leaf].parent;
+    int grandparent = tree->nodes[parent].parent;
+    int sibling = (tree->nodes[parent].child1 == leaf) ? tree->nodes[parent].child2 : tree->nodes[parent].child1;
+
+    replace_child(tree, grandparent, parent, sibling);
+    tree->nodes[sibling].parent = grandparent;
+    free_node(tree, parent);
+    refit_ancestors(tree, grandparent);
+}
+
+// max_speed is the furthest any body moves in a frame, the fat bounds are sized from it
+void create_aabb_tree(AABB_TREE* tree, BODY_STORE* store, int capacity, int world_width, int world_height, int max_speed) {
+    tree->store = store;
+    tree->nodes_capacity = 2 * capacity;
+    tree->nodes = (AABB_TREE_NODE*)malloc(tree->nodes_capacity * sizeof(AABB_TREE_NODE));
+    link_free_nodes(tree, 0);
+    tree->root = AABB_TREE_NULL;
+    tree->proxies = (AABB_TREE_PROXY*)malloc(capacity * sizeof(AABB_TREE_PROXY));
+    tree->count = 0;
+    tree->capacity = capacity;
+    tree->world_width = world_width;
+    tree->world_height = world_height;
+    tree->margin = AABB_TREE_MARGIN_FRAMES * max_speed;
+}
+
+void tree_add_body(AABB_TREE* tree, BODY_HANDLE body) {
+    if (tree->count == tree->capacity) {
+        tree->capacity *= 2;
+        tree->proxies = (AABB_TREE_PROXY*)realloc(tree->proxies, tree->capacity * sizeof(AABB_TREE_PROXY));
+    }
+
+    int leaf = allocate_node(tree);
+    tree->nodes[leaf].aabb = fatten(tree, body_aabb(tree->store, body));
+    tree->nodes[leaf].proxy = tree->count;
+    insert_leaf(tree, leaf);
+
+    tree->proxies[tree->count].body = body;
+    tree->proxies[tree->count].leaf = leaf;
+    tree->count++;
+}
+
+void tree_remove_body(AABB_TREE* tree, BODY_HANDLE body) {
+    for (int i = 0; i < tree->count; i++) {
+        if (same_body(tree->proxies[i].body, body)) {
+            remove_leaf(tree, tree->proxies[i].leaf);
+            free_node(tree, tree->proxies[i].leaf);
+
+            tree->proxies[i] = tree->proxies[--tree->count];
+            if (i < tree->count)
+                tree->nodes[tree->proxies[i].leaf].proxy = i;
+            return;
+        }
+    }
+}
+
+void tree_clear(AABB_TREE* tree) {
+    link_free_nodes(tree, 0);
+    tree->root = AABB_TREE_NULL;
+    tree->count = 0;
+}
+
+void tree_update(AABB_TREE* tree) {
+    for (int i = 0; i < tree->count; i++) {
+        AABB_TREE_PROXY* proxy = &tree->proxies[i];
+        AABB* aabb = body_aabb(tree->store, proxy->body);
+        if (aabb_contains(&tree->nodes[proxy->leaf].aabb, aabb))
+            continue;
+
+        remove_leaf(tree, proxy->leaf);
+        tree->nodes[proxy->leaf].aabb = fatten(tree, aabb);
+        insert_leaf(tree, proxy->leaf);
+    }
+}
+
+// collect the leaves overlapping the body's aabb moved by (shift_x, shift_y). the shifted
+// queries are ghosts across the seams, they may pair with any other proxy while the plain
+// query keeps to higher indices so each pair is reported once
+static void tree_query(AABB_TREE* tree, int proxy, int shift_x, int shift_y, int* stack, PAIR_LIST* pair_list) {
+    BODY_HANDLE body = tree->proxies[proxy].body;
+    AABB query = *body_aabb(tree->store, body);
+    int top = 0;
+
+    query.min.x += shift_x;
+    query.max.x += shift_x;
+    query.min.y += shift_y;
+    query.max.y += shift_y;
+    stack[top++] = tree->root;
+
+    while (top > 0) {
+        AABB_TREE_NODE* node = &tree->nodes[stack[--top]];
+        if (!aabb_overlap(&node->aabb, &query))
+            continue;
+
+        if (node->height == 0) {
+            BODY_HANDLE other = tree->proxies[node->proxy].body;
+            int ghost = (shift_x != 0 || shift_y != 0);
+            if ((ghost ? node->proxy != proxy : node->proxy > proxy) && aabb_overlap(&query, body_aabb(tree->store, other)))
+                add_pair(pair_list, body, other, -shift_x, -shift_y);
+        } else {
+            stack[top++] = node->child1;
+            stack[top++] = node->child2;
+        }
+    }
+}
+
+void tree_find_pairs(AABB_TREE* tree, PAIR_LIST* pair_list) {
+    int stack[AABB_TREE_STACK_SIZE];
+    // one ghost per pair of wrapped bodies: every x wrap is found from the body shifted left,
+    // a pure y wrap from the body shifted up
+    int ghost_shifts[4][2] = {
+        { -tree->world_width, 0 },
+        { -tree->world_width, -tree->world_height },
+        { -tree->world_width, tree->world_height },
+        { 0, -tree->world_height }
+    };
+
+    if (tree->root == AABB_TREE_NULL)
+        return;
+
+    for (int i = 0; i < tree->count; i++) {
+        tree_query(tree, i, 0, 0, stack, pair_list);
+        for (int k = 0; k < 4; k++)
+            tree_query(tree, i, ghost_shifts[k][0], ghost_shifts[k][1], stack, pair_list);
+    }
+}
+
+void create_broadphase(BROADPHASE* broadphase, BROADPHASE_TYPE type, BODY_STORE* store, int world_width, int world_height, int max_speed) {
+    broadphase->type = type;
+    switch (type) {
+    case BROADPHASE_GRID:
+        create_spatial_grid(&broadphase->grid, store, BROADPHASE_INITIAL_CAPACITY, world_width, world_height);
+        break;
+    case BROADPHASE_TREE:
+        create_aabb_tree(&broadphase->tree, store, BROADPHASE_INITIAL_CAPACITY, world_width, world_height, max_speed);
+        break;
+    default:
+        create_sweep_and_prune(&broadphase->sap, store, BROADPHASE_INITIAL_CAPACITY, world_width, world_height);
+        break;
+    }
+}
+
+void broadphase_add_body(BROADPHASE* broadphase, BODY_HANDLE body) {
+    switch (broadphase->type) {
+    case BROADPHASE_GRID:
+        grid_add_body(&broadphase->grid, body);
+        break;
+    case BROADPHASE_TREE:
+        tree_add_body(&broadphase->tree, body);
+        break;
+    default:
+        sap_add_body(&broadphase->sap, body);
+        break;
+    }
+}
+
+void broadphase_remove_body(BROADPHASE* broadphase, BODY_HANDLE body) {
+    switch (broadphase->type) {
+    case BROADPHASE_GRID:
+        grid_remove_body(&broadphase->grid, body);
+        break;
+    case BROADPHASE_TREE:
+        tree_remove_body(&broadphase->tree, body);
+        break;
+    default:
+        sap_remove_body(&broadphase->sap, body);
+        break;
+    }
+}
+
+void broadphase_clear(BROADPHASE* broadphase) {
+    switch (broadphase->type) {
+    case BROADPHASE_GRID:
+        grid_clear(&broadphase->grid);
+        break;
+    case BROADPHASE_TREE:
+        tree_clear(&broadphase->tree);
+        break;
+    default:
+        sap_clear(&broadphase->sap);
+        break;
+    }
+}
+
+int broadphase_count(BROADPHASE* broadphase) {
+    switch (broadphase->type) {
+    case BROADPHASE_GRID:
+        return broadphase->grid.count;
+    case BROADPHASE_TREE:
+        return broadphase->tree.count;
+    default:
+        return broadphase->sap.count;
+    }
+}
+
+// the pairs live in frame_arena and are only valid until it is reset
+void broadphase_find_pairs(BROADPHASE* broadphase, ARENA* frame_arena, COLLISION_PAIR* p_pairs[], int* p_num_pairs) {
+    PAIR_LIST pair_list = {NULL, 0, 0, frame_arena};
+
+    switch (broadphase->type) {
+    case BROADPHASE_GRID:
+        grid_find_pairs(&broadphase->grid, &pair_list);
+        break;
+    case BROADPHASE_TREE:
+        tree_update(&broadphase->tree);
+        tree_find_pairs(&broadphase->tree, &pair_list);
+        break;
+    default:
+        sap_update(&broadphase->sap);
+        sweep_and_prune(&broadphase->sap, &pair_list);
+        break;
+    }
+
+    *p_pairs = pair_list.pairs;
+    *p_num_pairs = pair_list.count;
+}
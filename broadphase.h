@@ -0,0 +1,136 @@
+#ifndef BROADPHASE_H
+#define BROADPHASE_H
+
+#include "body.h"
+
+#define BROADPHASE_INITIAL_CAPACITY 32
+#define GRID_CELL_SIZE 64 // a bit larger than the obstacles, so most bodies touch at most four cells
+#define AABB_TREE_MARGIN_FRAMES 2 // fat bounds cover this many frames of movement at the fastest speed
+#define AABB_TREE_NULL -1
+#define AABB_TREE_STACK_SIZE 256 // rotations keep the tree balanced, so queries never get close
+
+typedef enum {
+    BROADPHASE_SAP,
+    BROADPHASE_GRID,
+    BROADPHASE_TREE
+} BROADPHASE_TYPE;
+
+// two bodies whose bounding boxes overlap on both axes. the world wraps, so offset is
+// the translation that brings body2 next to body1 across the seams, usually zero
+typedef struct {
+    BODY_HANDLE body1;
+    BODY_HANDLE body2;
+    VECTOR offset;
+} COLLISION_PAIR;
+
+// output of the broad phase. the pairs and any temporaries of the search come from a frame
+// arena, so they are only valid until that arena is reset
+typedef struct {
+    COLLISION_PAIR* pairs;
+    int count;
+    int capacity;
+    ARENA* arena;
+} PAIR_LIST;
+
+typedef struct {
+    BODY_HANDLE body;
+    int min_x;
+    int max_x;
+    int min_y;
+    int max_y;
+} SAP_ENTRY;
+
+// entries stay sorted by min_x between frames. bodies only move a few pixels per frame,
+// so the order is nearly sorted and an insertion sort repairs it in close to linear time
+typedef struct {
+    BODY_STORE* store;
+    SAP_ENTRY* entries;
+    int count;
+    int capacity;
+    int world_width;
+    int world_height;
+} SWEEP_AND_PRUNE;
+
+// uniform grid over the wrapping world. cells are rebuilt every frame with a counting sort,
+// so bodies sharing an x range only meet the bodies in their own cells
+typedef struct {
+    BODY_STORE* store;
+    int world_width;
+    int world_height;
+    int cells_x;
+    int cells_y;
+    BODY_HANDLE* bodies;
+    int count;
+    int capacity;
+    int* cell_start; // cells_x*cells_y + 1 offsets into cell_entries
+    int* cell_cursor; // fill position of each cell while building
+    int* cell_entries; // body indices grouped by cell, rebuilt in the frame arena every search
+    int* last_tested; // per body, the index it was last paired against
+} SPATIAL_GRID;
+
+// leaves hold a fat copy of the body's aabb, internal nodes the union of their children
+typedef struct {
+    AABB aabb;
+    int parent; // doubles as the free list link for unused nodes
+    int child1;
+    int child2;
+    int height; // 0 for leaves, -1 for free nodes
+    int proxy;
+} AABB_TREE_NODE;
+
+typedef struct {
+    BODY_HANDLE body;
+    int leaf;
+} AABB_TREE_PROXY;
+
+// dynamic bounding volume hierarchy. a leaf is only reinserted once its body leaves
+// the fat box, so slow bodies leave the tree untouched for several frames
+typedef struct {
+    BODY_STORE* store;
+    AABB_TREE_NODE* nodes;
+    int nodes_capacity;
+    int root;
+    int free_list;
+    AABB_TREE_PROXY* proxies;
+    int count;
+    int capacity;
+    int world_width;
+    int world_height;
+    int margin; // how far the fat bounds reach past the body's own
+} AABB_TREE;
+
+typedef struct {
+    BROADPHASE_TYPE type;
+    SWEEP_AND_PRUNE sap;
+    SPATIAL_GRID grid;
+    AABB_TREE tree;
+} BROADPHASE;
+
+void create_sweep_and_prune(SWEEP_AND_PRUNE* sap, BODY_STORE* store, int capacity, int world_width, int world_height);
+void sap_add_body(SWEEP_AND_PRUNE* sap, BODY_HANDLE body);
+void sap_remove_body(SWEEP_AND_PRUNE* sap, BODY_HANDLE body);
+void sap_clear(SWEEP_AND_PRUNE* sap);
+void sap_update(SWEEP_AND_PRUNE* sap);
+void sweep_and_prune(SWEEP_AND_PRUNE* sap, PAIR_LIST* pair_list);
+
+void create_spatial_grid(SPATIAL_GRID* grid, BODY_STORE* store, int capacity, int world_width, int world_height);
+void grid_add_body(SPATIAL_GRID* grid, BODY_HANDLE body);
+void grid_remove_body(SPATIAL_GRID* grid, BODY_HANDLE body);
+void grid_clear(SPATIAL_GRID* grid);
+void grid_find_pairs(SPATIAL_GRID* grid, PAIR_LIST* pair_list);
+
+void create_aabb_tree(AABB_TREE* tree, BODY_STORE* store, int capacity, int world_width, int world_height, int max_speed);
+void tree_add_body(AABB_TREE* tree, BODY_HANDLE body);
+void tree_remove_body(AABB_TREE* tree, BODY_HANDLE body);
+void tree_clear(AABB_TREE* tree);
+void tree_update(AABB_TREE* tree);
+void tree_find_pairs(AABB_TREE* tree, PAIR_LIST* pair_list);
+
+void create_broadphase(BROADPHASE* broadphase, BROADPHASE_TYPE type, BODY_STORE* store, int world_width, int world_height, int max_speed);
+void broadphase_add_body(BROADPHASE* broadphase, BODY_HANDLE body);
+void broadphase_remove_body(BROADPHASE* broadphase, BODY_HANDLE body);
+void broadphase_clear(BROADPHASE* broadphase);
+int broadphase_count(BROADPHASE* broadphase);
+void broadphase_find_pairs(BROADPHASE* broadphase, ARENA* frame_arena, COLLISION_PAIR* p_pairs[], int* p_num_pairs);
+
+#endif  // BROADPHASE_H
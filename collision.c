@@ -8,6 +8,11 @@
 #include <stdlib.h>
 #include <time.h>
 
+#ifdef ENABLE_PROFILING
+int g_gjk_iterations;
+int g_gjk_pairs;
+#endif
+
 int is_colliding(VECTOR vertices[], int vertices_count) {
 #ifdef ENABLE_PROFILING
     // //START TRACKING HERE
@@ -22,14 +27,14 @@ int is_colliding(VECTOR vertices[], int vertices_count) {
         p1 = vertices[i];
         p2 = vertices[i+1]; 
 
-        if( (0 < p1.y) != (0 < p2.y) && 0 < p1.x + ( (-p1.y)/(p2.y-p1.y) )*(p2.x-p1.x) )
+        if( (0 < p1.y) != (0 < p2.y) && 0 < p1.x + ( (double)(-p1.y)/(p2.y-p1.y) )*(p2.x-p1.x) )
             counter++;
     }
 
     p1 = vertices[i];
     p2 = vertices[0]; // this will connect the last point to the first point, completing the polygon.
 
-        if( (0 < p1.y) != (0 < p2.y) && 0 < p1.x + ( (-p1.y)/(p2.y-p1.y) )*(p2.x-p1.x) )
+        if( (0 < p1.y) != (0 < p2.y) && 0 < p1.x + ( (double)(-p1.y)/(p2.y-p1.y) )*(p2.x-p1.x) )
             counter++;
 #ifdef ENABLE_PROFILING
     end_time = current_microseconds();
@@ -37,4 +42,501 @@ int is_colliding(VECTOR vertices[], int vertices_count) {
     printf("elapsed time of is_colliding : %.4f us\n", time);
 #endif
     return (counter % 2 == 1);
-}
\ No newline at end of file
+}
+
+// farthest vertex of set along direction
+static VECTOR support(VECTOR set[], int set_size, VECTOR direction) {
+    int best = 0;
+    double best_dot = dot_multiply(set[0], direction);
+    for (int i = 1; i < set_size; i++) {
+        double dot = dot_multiply(set[i], direction);
+        if (dot > best_dot) {
+            best_dot = dot;
+            best = i;
+        }
+    }
+    return set[best];
+}
+
+// farthest point of the minkowski difference set1 - (set2 + offset) along direction, without building the difference
+static VECTOR minkowski_support(VECTOR set1[], int set1_size, VECTOR set2[], int set2_size, VECTOR offset, VECTOR direction) {
+    VECTOR negated = {-direction.x, -direction.y};
+    VECTOR p1 = support(set1, set1_size, direction);
+    VECTOR p2 = support(set2, set2_size, negated);
+    VECTOR result = {p1.x - p2.x - offset.x, p1.y - p2.y - offset.y};
+    return result;
+}
+
+// perpendicular of edge pointing towards the side of point
+static VECTOR perpendicular_towards(VECTOR edge, VECTOR point) {
+    VECTOR perp = {-edge.y, edge.x};
+    if (dot_multiply(perp, point) < 0) {
+        perp.x = -perp.x;
+        perp.y = -perp.y;
+    }
+    return perp;
+}
+
+// reduces the simplex to the feature closest to the origin and picks the next search direction.
+// simplex[count - 1] is always the newest point. returns true once the simplex encloses the origin
+static int update_simplex(VECTOR simplex[], int* p_count, VECTOR* p_direction) {
+    VECTOR a = simplex[*p_count - 1];
+    VECTOR ao = {-a.x, -a.y};
+
+    if (*p_count == 2) {
+        VECTOR b = simplex[0];
+        VECTOR ab = {b.x - a.x, b.y - a.y};
+        *p_direction = perpendicular_towards(ab, ao);
+        // origin lies on the segment
+        return dot_multiply(*p_direction, ao) == 0;
+    }
+
+    VECTOR b = simplex[1];
+    VECTOR c = simplex[0];
+    VECTOR ab = {b.x - a.x, b.y - a.y};
+    VECTOR ac = {c.x - a.x, c.y - a.y};
+    VECTOR ab_perp = perpendicular_towards(ab, (VECTOR){-ac.x, -ac.y});
+    VECTOR ac_perp = perpendicular_towards(ac, (VECTOR){-ab.x, -ab.y});
+
+    if (dot_multiply(ab_perp, ao) > 0) {
+        simplex[0] = b;
+        simplex[1] = a;
+        *p_count = 2;
+        *p_direction = ab_perp;
+        return false;
+    }
+    if (dot_multiply(ac_perp, ao) > 0) {
+        simplex[1] = a;
+        *p_count = 2;
+        *p_direction = ac_perp;
+        return false;
+    }
+    return true;
+}
+
+// runs gjk and leaves the final simplex behind, which encloses the origin when colliding
+static int gjk(VECTOR set1[], int set1_size, VECTOR set2[], int set2_size, VECTOR offset, VECTOR simplex[], int* p_count, int* p_iterations) {
+    int count = 0;
+    int iterations = 0;
+    int colliding = false;
+    VECTOR direction = {set1[0].x - set2[0].x - offset.x, set1[0].y - set2[0].y - offset.y};
+
+    if (direction.x == 0 && direction.y == 0)
+        direction.x = 1;
+
+    simplex[count++] = minkowski_support(set1, set1_size, set2, set2_size, offset, direction);
+    direction.x = -simplex[0].x;
+    direction.y = -simplex[0].y;
+
+    if (direction.x == 0 && direction.y == 0) {
+        colliding = true; // origin is a support point, shapes are touching
+    } else {
+        while (iterations < GJK_MAX_ITERATIONS) {
+            iterations++;
+            VECTOR point = minkowski_support(set1, set1_size, set2, set2_size, offset, direction);
+
+            // could not pass the origin, or no progress was made
+            if (dot_multiply(point, direction) <= 0)
+                break;
+            int repeated = false;
+            for (int i = 0; i < count; i++) {
+                if (simplex[i].x == point.x && simplex[i].y == point.y)
+                    repeated = true;
+            }
+            if (repeated)
+                break;
+
+            simplex[count++] = point;
+            if (update_simplex(simplex, &count, &direction)) {
+                colliding = true;
+                break;
+            }
+        }
+    }
+
+    *p_count = count;
+    if (p_iterations != NULL)
+        *p_iterations = iterations;
+    return colliding;
+}
+
+int gjk_is_colliding(VECTOR set1[], int set1_size, VECTOR set2[], int set2_size, VECTOR offset, int* p_iterations) {
+#ifdef ENABLE_PROFILING
+    long long start_time, end_time;
+    double time = 0.0;
+    start_time = current_microseconds();
+    int iterations = 0;
+    if (p_iterations == NULL)
+        p_iterations = &iterations;
+#endif
+    VECTOR simplex[3];
+    int count = 0;
+    int colliding = gjk(set1, set1_size, set2, set2_size, offset, simplex, &count, p_iterations);
+#ifdef ENABLE_PROFILING
+    g_gjk_iterations += *p_iterations;
+    g_gjk_pairs++;
+    end_time = current_microseconds();
+    time = (end_time-start_time);
+    printf("elapsed time of gjk : %.4f us, %d iterations\n", time, *p_iterations);
+#endif
+    return colliding;
+}
+
+// fallback for touching shapes where gjk stops before building a triangle, separate along the centroids
+static void centroid_contact(VECTOR set1[], int set1_size, VECTOR set2[], int set2_size, VECTOR offset, CONTACT* contact) {
+    double x = offset.x, y = offset.y;
+    for (int i = 0; i < set1_size; i++) {
+        x -= (double)set1[i].x / set1_size;
+        y -= (double)set1[i].y / set1_size;
+    }
+    for (int j = 0; j < set2_size; j++) {
+        x += (double)set2[j].x / set2_size;
+        y += (double)set2[j].y / set2_size;
+    }
+    double length = sqrt(x * x + y * y);
+    contact->normal_x = (length > 0) ? x / length : 1.0;
+    contact->normal_y = (length > 0) ? y / length : 0.0;
+    contact->depth = 0.0;
+}
+
+static int complete_triangle(VECTOR set1[], int set1_size, VECTOR set2[], int set2_size, VECTOR offset, VECTOR simplex[], int* p_count) {
+    VECTOR axes[] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+
+    for (int i = 0; i < ARRAY_SIZE(axes) && *p_count == 1; i++) {
+        VECTOR point = minkowski_support(set1, set1_size, set2, set2_size, offset, axes[i]);
+        if (point.x != simplex[0].x || point.y != simplex[0].y)
+            simplex[(*p_count)++] = point;
+    }
+    if (*p_count == 1)
+        return false;
+
+    VECTOR edge = {simplex[1].x - simplex[0].x, simplex[1].y - simplex[0].y};
+    VECTOR normals[] = {{-edge.y, edge.x}, {edge.y, -edge.x}};
+    for (int i = 0; i < ARRAY_SIZE(normals); i++) {
+        VECTOR point = minkowski_support(set1, set1_size, set2, set2_size, offset, normals[i]);
+        VECTOR to_point = {point.x - simplex[0].x, point.y - simplex[0].y};
+        if (cross_multiply(edge, to_point) != 0) {
+            simplex[(*p_count)++] = point;
+            return true;
+        }
+    }
+    return false;
+}
+
+// expands the gjk simplex towards the boundary of set1 - (set2 + offset) until the edge closest to the origin is found.
+// that edge gives the contact normal (from set1 towards set2) and the penetration depth along it
+int epa_penetration(VECTOR set1[], int set1_size, VECTOR set2[], int set2_size, VECTOR offset, CONTACT* contact) {
+#ifdef ENABLE_PROFILING
+    long long start_time, end_time;
+    double time = 0.0;
+    start_time = current_microseconds();
+#endif
+    VECTOR polytope[EPA_MAX_VERTICES];
+    int count = 0;
+    int iterations = 0;
+
+    // gjk decides whether they collide at all, so callers need no separate test first
+    int gjk_iterations = 0;
+    int colliding = gjk(set1, set1_size, set2, set2_size, offset, polytope, &count, &gjk_iterations);
+#ifdef ENABLE_PROFILING
+    g_gjk_iterations += gjk_iterations;
+    g_gjk_pairs++;
+#endif
+    if (!colliding)
+        return false;
+
+    // gjk can stop on a point or segment touching the origin, grow it into a triangle first
+    if (count < 3 && !complete_triangle(set1, set1_size, set2, set2_size, offset, polytope, &count)) {
+        centroid_contact(set1, set1_size, set2, set2_size, offset, contact);
+        return true;
+    }
+
+    // keep the polytope at positive orientation so (edge.y, -edge.x) is the outward normal
+    if (cross_multiply((VECTOR){polytope[1].x - polytope[0].x, polytope[1].y - polytope[0].y},
+                       (VECTOR){polytope[2].x - polytope[0].x, polytope[2].y - polytope[0].y}) < 0) {
+        VECTOR temp = polytope[1];
+        polytope[1] = polytope[2];
+        polytope[2] = temp;
+    }
+
+    while (true) {
+        int closest = 0;
+        double closest_distance = INFINITY;
+        VECTOR closest_normal = {0, 0};
+
+        for (int i = 0; i < count; i++) {
+            VECTOR p1 = polytope[i];
+            VECTOR p2 = polytope[(i + 1) % count];
+            VECTOR normal = {p2.y - p1.y, -(p2.x - p1.x)};
+            double length = sqrt(dot_multiply(normal, normal));
+            if (length == 0)
+                continue;
+            double distance = dot_multiply(normal, p1) / length;
+            if (distance < closest_distance) {
+                closest_distance = distance;
+                closest_normal = normal;
+                closest = i;
+            }
+        }
+
+        double length = sqrt(dot_multiply(closest_normal, closest_normal));
+        VECTOR point = minkowski_support(set1, set1_size, set2, set2_size, offset, closest_normal);
+        double point_distance = dot_multiply(point, closest_normal) / length;
+        iterations++;
+
+        if (point_distance - closest_distance < EPA_TOLERANCE || count == EPA_MAX_VERTICES || iterations == EPA_MAX_ITERATIONS) {
+            contact->normal_x = closest_normal.x / length;
+            contact->normal_y = closest_normal.y / length;
+            contact->depth = closest_distance;
+            break;
+        }
+
+        for (int i = count; i > closest + 1; i--)
+            polytope[i] = polytope[i - 1];
+        polytope[closest + 1] = point;
+        count++;
+    }
+#ifdef ENABLE_PROFILING
+    end_time = current_microseconds();
+    time = (end_time-start_time);
+    printf("elapsed time of epa : %.4f us, %d iterations\n", time, iterations);
+#endif
+    return true;
+}
+
+// with the whole minkowski difference at hand the edge closest to the origin is the contact, no expansion needed.
+// the origin is inside, so each edge normal is flipped to point away from it whichever way the hull winds
+static void hull_penetration(VECTOR hull[], int hull_size, CONTACT* contact) {
+    double closest_distance = INFINITY;
+
+    contact->normal_x = 1.0;
+    contact->normal_y = 0.0;
+    contact->depth = 0.0;
+    for (int i = 0; i < hull_size; i++) {
+        VECTOR p1 = hull[i];
+        VECTOR p2 = hull[(i + 1) % hull_size];
+        VECTOR normal = {p2.y - p1.y, -(p2.x - p1.x)};
+        double length = sqrt(dot_multiply(normal, normal));
+        if (length == 0)
+            continue;
+        double distance = dot_multiply(normal, p1) / length;
+        if (distance < 0) {
+            distance = -distance;
+            normal.x = -normal.x;
+            normal.y = -normal.y;
+        }
+        if (distance < closest_distance) {
+            closest_distance = distance;
+            contact->normal_x = normal.x / length;
+            contact->normal_y = normal.y / length;
+            contact->depth = distance;
+        }
+    }
+}
+
+static void project(VECTOR set[], int set_size, VECTOR axis, double* p_min, double* p_max) {
+    *p_min = *p_max = dot_multiply(set[0], axis);
+    for (int i = 1; i < set_size; i++) {
+        double projection = dot_multiply(set[i], axis);
+        *p_min = fmin(*p_min, projection);
+        *p_max = fmax(*p_max, projection);
+    }
+}
+
+// tests the edge normals of axis_set as separating axes, keeping the axis of least overlap in contact.
+// edge directions do not depend on position, so axis_set can be either set. returns false on the first separating axis
+static int overlap_on_axes(VECTOR axis_set[], int axis_set_size, VECTOR set1[], int set1_size, VECTOR set2[], int set2_size, VECTOR offset, CONTACT* contact) {
+    for (int i = 0; i < axis_set_size; i++) {
+        VECTOR p1 = axis_set[i];
+        VECTOR p2 = axis_set[(i + 1) % axis_set_size];
+        VECTOR axis = {p1.y - p2.y, p2.x - p1.x};
+
+        if (axis.x == 0 && axis.y == 0)
+            continue;
+
+        // small polygons (boxes) have parallel edges, only test each direction once
+        int tested = false;
+        for (int j = 0; j < i && axis_set_size <= SAT_MAX_VERTICES; j++) {
+            VECTOR q1 = axis_set[j];
+            VECTOR q2 = axis_set[j + 1];
+            VECTOR edge = {q2.x - q1.x, q2.y - q1.y};
+            if (cross_multiply(edge, (VECTOR){p2.x - p1.x, p2.y - p1.y}) == 0)
+                tested = true;
+        }
+        if (tested)
+            continue;
+
+        double min1, max1, min2, max2;
+        project(set1, set1_size, axis, &min1, &max1);
+        project(set2, set2_size, axis, &min2, &max2);
+        min2 += dot_multiply(offset, axis);
+        max2 += dot_multiply(offset, axis);
+        if (max1 <= min2 || max2 <= min1)
+            return false;
+
+        double length = sqrt(dot_multiply(axis, axis));
+        double forward = (max1 - min2) / length; // set2 lies along +axis from set1
+        double backward = (max2 - min1) / length;
+        double depth = fmin(forward, backward);
+        if (depth < contact->depth) {
+            double sign = (forward <= backward) ? 1.0 : -1.0;
+            contact->normal_x = sign * axis.x / length;
+            contact->normal_y = sign * axis.y / length;
+            contact->depth = depth;
+        }
+    }
+    return true;
+}
+
+// separating axis test for convex polygons, exits on the first separating axis.
+// the smaller polygon's axes go first since they are the cheapest to reject with
+int sat_is_colliding(VECTOR set1[], int set1_size, VECTOR set2[], int set2_size, VECTOR offset, CONTACT* contact) {
+#ifdef ENABLE_PROFILING
+    long long start_time, end_time;
+    double time = 0.0;
+    start_time = current_microseconds();
+#endif
+    CONTACT best = {1.0, 0.0, INFINITY};
+    int colliding;
+
+    if (set1_size <= set2_size) {
+        colliding = overlap_on_axes(set1, set1_size, set1, set1_size, set2, set2_size, offset, &best)
+            && overlap_on_axes(set2, set2_size, set1, set1_size, set2, set2_size, offset, &best);
+    } else {
+        colliding = overlap_on_axes(set2, set2_size, set1, set1_size, set2, set2_size, offset, &best)
+            && overlap_on_axes(set1, set1_size, set1, set1_size, set2, set2_size, offset, &best);
+    }
+
+    if (colliding && contact != NULL)
+        *contact = best;
+#ifdef ENABLE_PROFILING
+    end_time = current_microseconds();
+    time = (end_time-start_time);
+    printf("elapsed time of sat : %.4f us\n", time);
+#endif
+    return colliding;
+}
+
+// vertex based narrow phase, picked by vertex count: sat when either polygon is small, otherwise
+// epa, whose gjk pass is also the collision test, or the minkowski difference and its closest edge
+static int polygon_polygon(POLYGON* polygon1, POLYGON* polygon2, VECTOR offset, CONTACT* contact) {
+    if (polygon1->vertices_idx <= SAT_MAX_VERTICES || polygon2->vertices_idx <= SAT_MAX_VERTICES)
+        return sat_is_colliding(polygon1->vertices, polygon1->vertices_idx, polygon2->vertices, polygon2->vertices_idx, offset, contact);
+
+#ifdef ENABLE_GJK
+    return epa_penetration(polygon1->vertices, polygon1->vertices_idx, polygon2->vertices, polygon2->vertices_idx, offset, contact);
+#else
+    VECTOR result[MAX_MINKOWSKI_VERTICES];
+    int result_size = calculate_minkowski_diff(polygon1->vertices, polygon1->vertices_idx, polygon2->vertices, polygon2->vertices_idx, offset, result);
+    if (!is_colliding(result, result_size))
+        return false;
+    hull_penetration(result, result_size, contact);
+    return true;
+#endif
+}
+
+static int circle_circle(POLYGON* circle1, POLYGON* circle2, VECTOR offset, CONTACT* contact) {
+    double dx = circle2->center.x + offset.x - circle1->center.x;
+    double dy = circle2->center.y + offset.y - circle1->center.y;
+    double radii = circle1->radius + circle2->radius;
+    double distance_squared = dx * dx + dy * dy;
+
+    if (distance_squared >= radii * radii)
+        return false;
+
+    double distance = sqrt(distance_squared);
+    contact->normal_x = (distance > 0) ? dx / distance : 1.0;
+    contact->normal_y = (distance > 0) ? dy / distance : 0.0;
+    contact->depth = radii - distance;
+    return true;
+}
+
+static int circle_box(POLYGON* circle, POLYGON* box, VECTOR offset, CONTACT* contact) {
+    int min_x = box->center.x + offset.x - box->half_extents.x;
+    int max_x = box->center.x + offset.x + box->half_extents.x;
+    int min_y = box->center.y + offset.y - box->half_extents.y;
+    int max_y = box->center.y + offset.y + box->half_extents.y;
+
+    // closest point of the box to the circle center
+    double closest_x = fmax(min_x, fmin(circle->center.x, max_x));
+    double closest_y = fmax(min_y, fmin(circle->center.y, max_y));
+    double dx = closest_x - circle->center.x;
+    double dy = closest_y - circle->center.y;
+    double distance_squared = dx * dx + dy * dy;
+
+    if (distance_squared >= (double)circle->radius * circle->radius)
+        return false;
+
+    if (distance_squared > 0) {
+        double distance = sqrt(distance_squared);
+        contact->normal_x = dx / distance;
+        contact->normal_y = dy / distance;
+        contact->depth = circle->radius - distance;
+        return true;
+    }
+
+    // center is inside the box, the circle leaves through the nearest face
+    double left = circle->center.x - min_x;
+    double right = max_x - circle->center.x;
+    double top = circle->center.y - min_y;
+    double bottom = max_y - circle->center.y;
+    double nearest = fmin(fmin(left, right), fmin(top, bottom));
+
+    contact->normal_x = (nearest == left) ? 1.0 : (nearest == right) ? -1.0 : 0.0;
+    contact->normal_y = (contact->normal_x != 0.0) ? 0.0 : (nearest == top) ? 1.0 : -1.0;
+    contact->depth = circle->radius + nearest;
+    return true;
+}
+
+static int box_circle(POLYGON* box, POLYGON* circle, VECTOR offset, CONTACT* contact) {
+    VECTOR reverse = {-offset.x, -offset.y};
+    if (!circle_box(circle, box, reverse, contact))
+        return false;
+    contact->normal_x = -contact->normal_x;
+    contact->normal_y = -contact->normal_y;
+    return true;
+}
+
+static int box_box(POLYGON* box1, POLYGON* box2, VECTOR offset, CONTACT* contact) {
+    int dx = box2->center.x + offset.x - box1->center.x;
+    int dy = box2->center.y + offset.y - box1->center.y;
+    int overlap_x = box1->half_extents.x + box2->half_extents.x - abs(dx);
+    int overlap_y = box1->half_extents.y + box2->half_extents.y - abs(dy);
+
+    if (overlap_x <= 0 || overlap_y <= 0)
+        return false;
+
+    if (overlap_x < overlap_y) {
+        contact->normal_x = (dx < 0) ? -1.0 : 1.0;
+        contact->normal_y = 0.0;
+        contact->depth = overlap_x;
+    } else {
+        contact->normal_x = 0.0;
+        contact->normal_y = (dy < 0) ? -1.0 : 1.0;
+        contact->depth = overlap_y;
+    }
+    return true;
+}
+
+// specialised test for every pair of shape types, general polygons fall back to their vertices
+static COLLISION_TEST collision_table[SHAPE_TYPE_COUNT][SHAPE_TYPE_COUNT] = {
+    [SHAPE_CIRCLE] = {
+        [SHAPE_CIRCLE] = circle_circle,
+        [SHAPE_BOX] = circle_box,
+        [SHAPE_POLYGON] = polygon_polygon,
+    },
+    [SHAPE_BOX] = {
+        [SHAPE_CIRCLE] = box_circle,
+        [SHAPE_BOX] = box_box,
+        [SHAPE_POLYGON] = polygon_polygon,
+    },
+    [SHAPE_POLYGON] = {
+        [SHAPE_CIRCLE] = polygon_polygon,
+        [SHAPE_BOX] = polygon_polygon,
+        [SHAPE_POLYGON] = polygon_polygon,
+    },
+};
+
+int detect_collision(POLYGON* polygon1, POLYGON* polygon2, VECTOR offset, CONTACT* contact) {
+    return collision_table[polygon1->type][polygon2->type](polygon1, polygon2, offset, contact);
+}
@@ -4,5 +4,30 @@
 #include <stdbool.h>
 #include "vector.h"
 
+#define GJK_MAX_ITERATIONS 32
+#define EPA_MAX_ITERATIONS 32
+#define EPA_MAX_VERTICES (MAX_MINKOWSKI_VERTICES + 3)
+#define EPA_TOLERANCE 0.01
+#define SAT_MAX_VERTICES 8 // pairs where either polygon has at most this many vertices use sat
+
+// normal points from the first polygon towards the second, depth is how far they overlap along it
+typedef struct {
+    double normal_x;
+    double normal_y;
+    double depth;
+} CONTACT;
+
+// shapes are in local space, offset places the second one relative to the first
+typedef int (*COLLISION_TEST)(POLYGON* polygon1, POLYGON* polygon2, VECTOR offset, CONTACT* contact);
+
 int is_colliding(VECTOR vertices[], int vertices_count);
+int gjk_is_colliding(VECTOR set1[], int set1_size, VECTOR set2[], int set2_size, VECTOR offset, int* p_iterations);
+int epa_penetration(VECTOR set1[], int set1_size, VECTOR set2[], int set2_size, VECTOR offset, CONTACT* contact);
+int sat_is_colliding(VECTOR set1[], int set1_size, VECTOR set2[], int set2_size, VECTOR offset, CONTACT* contact);
+int detect_collision(POLYGON* polygon1, POLYGON* polygon2, VECTOR offset, CONTACT* contact);
+
+#ifdef ENABLE_PROFILING
+extern int g_gjk_iterations;
+extern int g_gjk_pairs;
+#endif
 #endif  // COLLISION_H
@@ -1,8 +1,7 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdbool.h>
-#ifdef ENABLE_OPENCL
-#include "CL/cl.h"
-#endif
+#include <string.h>
 #include "SDL2/SDL.h"
 #include "SDL2/SDL_image.h"
 #include "collision.h"
@@ -11,66 +10,72 @@
 #include <time.h>
 #include <math.h>
 #include "vector.h"
+#include "body.h"
+#include "broadphase.h"
+#include "narrowphase_cl.h"
+#include "scheduler.h"
+#include "threadpool.h"
 #include "SDL2/SDL_ttf.h"
 #include <time.h>
 
-#ifdef ENABLE_OPENCL
-const char *minkowski_kernel_str =
-    "   typedef struct {\n"
-    "       int x;\n"
-    "       int y;\n"
-    "   } VECTOR;\n"
-
-    "__kernel void calculate_minkowski_diff(__global VECTOR* set1, const int set1_size, __global VECTOR* set2, const int set2_size, __global VECTOR* result) {\n"
-    
-    "    int gid_set1 = get_global_id(0);\n"
-    "    int gid_set2 = get_global_id(1);\n"
-    "\n"
-
-    "    int result_idx = gid_set1 * set2_size + gid_set2; \n"
-    "\n"
-
-    // "    printf(\"gid_set1 %d, gid_set2 %d\", gid_set1, gid_set2);\n"
-    "    if (gid_set1 < set1_size && gid_set2 < set2_size) {\n"
-    "\n"
-    "       result[result_idx].x = set1[gid_set1].x - set2[gid_set2].x;\n"  
-    "       result[result_idx].y = set1[gid_set1].y - set2[gid_set2].y;\n"
-    "    }\n"
-    "}\n";
-
-const char *collision_kernel_str =
-    "   typedef struct {\n"
-    "       int x;\n"
-    "       int y;\n"
-    "   } VECTOR;\n"
-
-    "   __kernel void is_colliding(__global VECTOR* result, const int result_size, __global int* colliding) {\n"
-    "       int gid = get_global_id(0);\n"
-    "       int vertices_count = result_size;\n"
-    "       int counter = 0;\n"
-    "       for (int i = 0; i < vertices_count; i++) {\n"
-    "           VECTOR p1 = result[i];\n"
-    "           VECTOR p2 = result[(i + 1) % vertices_count];\n"
-    "           if ((0 < p1.y) != (0 < p2.y) && 0 < p1.x + ((-p1.y) / (p2.y - p1.y)) * (p2.x - p1.x))\n"
-    "               counter++;\n"
-    "       }\n"
-    // "       printf(\"colliding[0] %d\", (counter % 2 == 1));        \n"
-    "       colliding[0] = (counter % 2 == 1);\n"
-    "   }\n";
-#endif
-
 #define RECTANGLE_WIDTH 20
 #define RECTANGLE_HEIGHT 20
 #define RECTANGLE_SPEED 4
+#define OBSTACLE_MAX_SPEED (3 * RECTANGLE_SPEED - 1) // obstacles spawn at rand() % (2 * RECTANGLE_SPEED) + RECTANGLE_SPEED
 #define WINDOW_WIDTH 800
 #define WINDOW_HEIGHT 600
-#define DIFFICULTY_COUNT 100
-
-POLYGON g_player;
-POLYGON_LIST g_polygon_list;
+#define FRAME_ARENA_SLAB_SIZE (64 * 1024)
+#define NARROW_PHASE_CHUNK_SIZE 32 // pairs a worker takes at a time
+
+BODY_STORE g_bodies;
+BODY_HANDLE g_player;
+ARENA g_shape_arena;
+POLYGON g_player_shape;
+POLYGON g_circle_shape;
+BROADPHASE g_broadphase;
+ARENA g_frame_arena; // per frame temporaries, reset at the top of every frame
+#ifdef ENABLE_OPENCL
+CL_NARROWPHASE g_cl;
+#endif
+PAIR_SCHEDULER g_scheduler;
+THREAD_POOL g_thread_pool;
+
+// the pairs of one frame's narrow phase, the device results first and then the pairs left to the cpu
+typedef struct {
+    COLLISION_PAIR* device_pairs;
+    int num_device_pairs;
+    COLLISION_PAIR* pairs;
 #ifdef ENABLE_OPENCL
-cl_context g_context;
+    int* pairs_colliding;
 #endif
+} NARROW_PHASE_JOB;
+
+typedef struct {
+    int pair; // index into the job
+    CONTACT contact;
+} PAIR_CONTACT;
+
+// one per thread, so workers never share a cache line. kept across frames
+typedef struct {
+    PAIR_CONTACT* contacts;
+    int count;
+    int capacity;
+    long long cpu_time; // microseconds this thread spent on the cpu's own pairs this frame
+    long long epa_time; // and on epa for the device results
+} CONTACT_BUFFER;
+
+CONTACT_BUFFER g_contact_buffers[THREAD_POOL_MAX_THREADS];
+
+// where the narrow phase runs. auto takes the first that comes up, in this order
+typedef enum {
+    BACKEND_AUTO,
+    BACKEND_GPU,
+    BACKEND_CPU, // opencl on the cpu
+    BACKEND_NATIVE
+} COMPUTE_BACKEND;
+
+static const char* backend_names[] = { "auto", "gpu", "cpu", "native" };
+COMPUTE_BACKEND g_backend = BACKEND_NATIVE;
 
 enum Screen {
     MAIN_SCREEN,
@@ -79,14 +84,21 @@ enum Screen {
     GAME_SCREEN
 };
 
+static void create_shapes();
 static void init_player();
-static void update_position(POLYGON* polygon); // take in pointer to polygon
-static void draw_polygon(SDL_Renderer* renderer, VECTOR vertices[], int vertex_count, SDL_Color color);
-static void sort_arr(POLYGON*** p_arr, int polygon_count);
-static void sweep_and_prune(POLYGON** p_arr, int num_polygons, int *p_collision_ids[], int *p_num_collisions);
-#ifdef ENABLE_OPENCL
-static void update_polygon_buffers(cl_command_queue queue, int p_collision_ids[], int num_collisions);
-#endif
+static VECTOR* player_velocity();
+static void spawn_circle(int center_x, int center_y, int velocity_y);
+static void update_position(int index); // dense index into g_bodies
+static void draw_polygon(SDL_Renderer* renderer, VECTOR vertices[], int vertex_count, VECTOR position, SDL_Color color);
+static void separate_polygons(int index1, int index2, CONTACT* contact);
+static VECTOR pair_offset(int index1, int index2, COLLISION_PAIR* pair);
+static int parse_backend(const char* name, COMPUTE_BACKEND* p_backend);
+static COMPUTE_BACKEND init_backend(COMPUTE_BACKEND requested);
+static COLLISION_PAIR* job_pair(NARROW_PHASE_JOB* job, int i);
+static void find_contacts(NARROW_PHASE_JOB* job, CONTACT_BUFFER* buffer, int begin, int end);
+static void narrow_phase_task(void* context, int begin, int end, int thread);
+static PAIR_CONTACT* gather_contacts(int* p_num_contacts);
+static int drop_repeated_contacts(NARROW_PHASE_JOB* job, PAIR_CONTACT contacts[], int num_contacts);
 
 int main(int argc, char *argv[])
 {
@@ -96,7 +108,6 @@ int main(int argc, char *argv[])
     uint32_t lastSpawnTime = SDL_GetTicks();
     int p_idx=0;
     int diff_count = 0;
-    POLYGON temp[DIFFICULTY_COUNT];
     enum Screen currentScreen = MAIN_SCREEN;
     int score = 0;
     char scoreText[20];
@@ -106,68 +117,41 @@ int main(int argc, char *argv[])
     int afkTime = 0;
     double scoreIncreaseInterval = 1.0;
     SDL_Color SDL_WHITE = {255, 255, 255, 255};
-    int colliding = 0;
-
+    BROADPHASE_TYPE broadphase_type = BROADPHASE_SAP;
+    COMPUTE_BACKEND backend = BACKEND_AUTO;
 #ifdef ENABLE_OPENCL
-    int local_size = 0;
-    cl_uint num_devices, num_platforms;
-    cl_device_id device;
-    cl_platform_id platform;
-    cl_command_queue queue;
-    cl_kernel kernel;
-    cl_kernel kernel_2;
-
-    DBG_PRINT("Getting OpenCL platform IDs...\n");
-    status = clGetPlatformIDs(1, &platform, &num_platforms);
-    if (status != CL_SUCCESS) {
-        printf("Error getting platform ID: %d\n", status);
-        goto Out;
-    }
-
-    DBG_PRINT("Getting OpenCL device IDs...\n");
-    status = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &device, NULL);
-    if (status != CL_SUCCESS) {
-        printf("Error getting device ID: %d\n", status);
-        goto Out;
-    }
-
-    DBG_PRINT("Creating OpenCL context...\n");
-    g_context = clCreateContext(NULL, 1, &device, NULL, NULL, &status);
-    if (status != CL_SUCCESS) {
-        
-        printf("Error creating context: %d\n", status);
-        goto Out;
-    }
-
-    DBG_PRINT("Creating OpenCL command queue...\n");
-    queue = clCreateCommandQueue(g_context, device, CL_QUEUE_PROFILING_ENABLE, &status);
-    if (status != CL_SUCCESS) {
-        printf("Error creating command queue: %d\n", status);
-        goto Out;
-    }
+    int device_broadphase = 0;
+#endif
 
-    DBG_PRINT("Creating OpenCL program with kernel source...\n");
-    cl_program program = clCreateProgramWithSource(g_context, 1, &minkowski_kernel_str, NULL, NULL);
-    status = clBuildProgram(program, 1, &device, NULL, NULL, NULL);
-    if (status != CL_SUCCESS) {
-        printf("Error building program: %d\n", status);
-        goto Out;
+    // the command line wins over the environment
+    if (getenv("MCCD_BACKEND") && !parse_backend(getenv("MCCD_BACKEND"), &backend))
+        printf("Ignoring unknown MCCD_BACKEND %s\n", getenv("MCCD_BACKEND"));
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--backend=", 10) == 0) {
+            if (!parse_backend(argv[i] + 10, &backend))
+                printf("Ignoring unknown option %s\n", argv[i]);
+        } else if (strcmp(argv[i], "--broadphase=grid") == 0)
+            broadphase_type = BROADPHASE_GRID;
+        else if (strcmp(argv[i], "--broadphase=tree") == 0)
+            broadphase_type = BROADPHASE_TREE;
+        else if (strcmp(argv[i], "--broadphase=sap") == 0)
+            broadphase_type = BROADPHASE_SAP;
+#ifdef ENABLE_OPENCL
+        else if (strcmp(argv[i], "--broadphase=device") == 0)
+            device_broadphase = 1;
+#endif
+        else
+            printf("Ignoring unknown option %s\n", argv[i]);
     }
 
-    DBG_PRINT("Creating OpenCL program with kernel source...\n");
-    cl_program program_2 = clCreateProgramWithSource(g_context, 1, &collision_kernel_str, NULL, NULL);
-    status = clBuildProgram(program_2, 1, &device, NULL, NULL, NULL);
-    if (status != CL_SUCCESS) {
-        printf("Error building program: %d\n", status);
-        goto Out;
+    g_backend = init_backend(backend);
+    create_pair_scheduler(&g_scheduler);
+    printf("Running the narrow phase on the %s backend\n", backend_names[g_backend]);
+#ifdef ENABLE_OPENCL
+    if (device_broadphase && g_backend == BACKEND_NATIVE) {
+        printf("No OpenCL device for the device broad phase, using sweep and prune\n");
+        device_broadphase = 0;
     }
-
-    DBG_PRINT("Creating OpenCL kernels...\n");
-    kernel = clCreateKernel(program, "calculate_minkowski_diff", NULL);
-    kernel_2 = clCreateKernel(program_2, "is_colliding", NULL);
-
-#else
-    DBG_PRINT("This application is running without an OpenCL kernel.\n");
 #endif
 
     status = SDL_Init(SDL_INIT_VIDEO);
@@ -176,6 +160,8 @@ int main(int argc, char *argv[])
         DBG_PRINT("Error initializing SDL: %s\n", SDL_GetError());
         goto Out;
     }
+    create_thread_pool(&g_thread_pool, SDL_GetCPUCount());
+    DBG_PRINT("Narrow phase on %d threads\n", g_thread_pool.num_threads);
 
     if (TTF_Init() == -1) {
         printf("Error initializing SDL TTF %s\n", TTF_GetError());
@@ -198,9 +184,12 @@ int main(int argc, char *argv[])
 
     SDL_Renderer *renderer = SDL_CreateRenderer(window, -1, 0);
 
+    create_shapes();
+    create_body_store(&g_bodies, BODY_STORE_INITIAL_CAPACITY);
+    create_arena(&g_frame_arena, FRAME_ARENA_SLAB_SIZE);
     init_player();
-    create_polygon_list(&g_polygon_list);
-    add_polygon_to_list(&g_polygon_list, &g_player);
+    create_broadphase(&g_broadphase, broadphase_type, &g_bodies, WINDOW_WIDTH, WINDOW_HEIGHT, OBSTACLE_MAX_SPEED);
+    broadphase_add_body(&g_broadphase, g_player);
 
     SDL_Texture *title = IMG_LoadTexture(renderer, "sprites/title.png");
     if (title == NULL) {
@@ -270,26 +259,12 @@ int main(int argc, char *argv[])
     }
 
 
-#ifdef ENABLE_OPENCL
-    cl_mem results_buffer = clCreateBuffer(g_context, CL_MEM_WRITE_ONLY, sizeof(VECTOR) * MAX_VERTICES*MAX_VERTICES, NULL, &status);
-    if (status != CL_SUCCESS) {
-        DBG_PRINT("Error collisionResultsBuffer clCreateBuffer: %d\n", status);
-    }
-
-    cl_mem colliding_buffer = clCreateBuffer(g_context, CL_MEM_WRITE_ONLY, sizeof(int), NULL, &status);
-    if (status != CL_SUCCESS) {
-        DBG_PRINT("Error collisionResultsBuffer clCreateBuffer: %d\n", status);
-    }
-
-    clSetKernelArg(kernel, 4, sizeof(cl_mem), &results_buffer);
-    clSetKernelArg(kernel_2, 0, sizeof(cl_mem), &results_buffer);
-    clSetKernelArg(kernel_2, 2, sizeof(cl_mem), &colliding_buffer);
-#endif
-
     while (running)
     {
         SDL_Event event;
 
+        arena_reset(&g_frame_arena);
+
         while (SDL_PollEvent(&event))
         {
             switch (event.type)
@@ -359,7 +334,7 @@ int main(int argc, char *argv[])
             case SDL_KEYDOWN:
                 switch (event.key.keysym.sym){
                     case SDLK_LEFT:
-                        set_velocity_x(&g_player, -RECTANGLE_SPEED);
+                        player_velocity()->x = -RECTANGLE_SPEED;
                         if(afkTime > 0){
                             afkTime-=1;
                         } else{
@@ -367,7 +342,7 @@ int main(int argc, char *argv[])
                         }
                         break;
                     case SDLK_RIGHT:
-                        set_velocity_x(&g_player, RECTANGLE_SPEED);
+                        player_velocity()->x = RECTANGLE_SPEED;
                         if(afkTime > 0){
                             afkTime-=1;
                         } else{
@@ -375,10 +350,10 @@ int main(int argc, char *argv[])
                         }
                         break;
                     case SDLK_UP:
-                        set_velocity_y(&g_player, -RECTANGLE_SPEED);
+                        player_velocity()->y = -RECTANGLE_SPEED;
                         break;
                     case SDLK_DOWN:
-                        set_velocity_y(&g_player, RECTANGLE_SPEED);
+                        player_velocity()->y = RECTANGLE_SPEED;
                         break;
                     default:
                         break;
@@ -387,20 +362,20 @@ int main(int argc, char *argv[])
             case SDL_KEYUP:
                 switch( event.key.keysym.sym ){
                     case SDLK_LEFT:
-                        if( g_player.velocity.x < 0 )
-                            g_player.velocity.x = 0;
+                        if( player_velocity()->x < 0 )
+                            player_velocity()->x = 0;
                         break;
                     case SDLK_RIGHT:
-                        if( g_player.velocity.x > 0 )
-                            g_player.velocity.x = 0;
+                        if( player_velocity()->x > 0 )
+                            player_velocity()->x = 0;
                         break;
                     case SDLK_UP:
-                        if( g_player.velocity.y < 0 )
-                            g_player.velocity.y = 0;
+                        if( player_velocity()->y < 0 )
+                            player_velocity()->y = 0;
                         break;
                     case SDLK_DOWN:
-                        if( g_player.velocity.y > 0 )
-                            g_player.velocity.y = 0;
+                        if( player_velocity()->y > 0 )
+                            player_velocity()->y = 0;
                         break;
                     default:
                         break;
@@ -415,10 +390,10 @@ int main(int argc, char *argv[])
 
         // delete all existing polygons and reinitiate them for next games
         if (free_polygons) {
-                delete_all_polygons(&g_polygon_list);
+                body_store_clear(&g_bodies);
                 init_player();
-                create_polygon_list(&g_polygon_list);
-                add_polygon_to_list(&g_polygon_list, &g_player);
+                broadphase_clear(&g_broadphase);
+                broadphase_add_body(&g_broadphase, g_player);
                 free_polygons = 0;
         }
 
@@ -472,10 +447,7 @@ int main(int argc, char *argv[])
             afkTime += 1;
             if(afkTime > 500 && p_idx < diff_count){ // maybe remove the p_idx < diff_count condition
                 int direction = (rand() % 2 == 0) ? 1 : -1;
-                create_circle(&temp[p_idx], g_player.vertices[0].x+10, WINDOW_HEIGHT, 20, MAX_VERTICES); 
-                set_velocity_y(&temp[p_idx], (rand() % (RECTANGLE_SPEED*2) +RECTANGLE_SPEED) * direction);
-                //set_velocity_y(&temp[p_idx], 4);
-                add_polygon_to_list(&g_polygon_list, &temp[p_idx]);
+                spawn_circle(g_bodies.aabbs[body_index(&g_bodies, g_player)].min.x+10, WINDOW_HEIGHT, (rand() % (RECTANGLE_SPEED*2) +RECTANGLE_SPEED) * direction);
                 p_idx++;
                 afkTime = 0;
             }
@@ -495,10 +467,7 @@ int main(int argc, char *argv[])
                 if(p_idx < diff_count){ 
                     int direction = (rand() % 2 == 0) ? 1 : -1;
                     // todo: change circles to spawn in random spots!
-                    create_circle(&temp[p_idx], rand() % (WINDOW_WIDTH), WINDOW_HEIGHT/2, 20, MAX_VERTICES);
-                    //set_velocity_x(&temp[p_idx], rand() % (RECTANGLE_SPEED*2) - 2);
-                    set_velocity_y(&temp[p_idx], (rand() % (RECTANGLE_SPEED*2) +RECTANGLE_SPEED) * direction);
-                    add_polygon_to_list(&g_polygon_list, &temp[p_idx]);
+                    spawn_circle(rand() % (WINDOW_WIDTH), WINDOW_HEIGHT/2, (rand() % (RECTANGLE_SPEED*2) +RECTANGLE_SPEED) * direction);
                     p_idx++;
                     lastSpawnTime = SDL_GetTicks();
                 }
@@ -506,154 +475,160 @@ int main(int argc, char *argv[])
 #ifdef ENABLE_PROFILING
             //START TRACKING HERE
             long long start_time, end_time;
+#ifdef ENABLE_OPENCL
             long long opencl_start_time, opencl_end_time;
-            long long copy_start_time, copy_end_time;
+#endif
             long long sweep_start_time, sweep_end_time;
-            double kernel_exe_time = 0.0, total_time = 0.0, copy_time = 0.0, sweep_time = 0.0;
+            double kernel_exe_time = 0.0, total_time = 0.0, sweep_time = 0.0, narrow_phase_time = 0.0;
+            int num_polygons = broadphase_count(&g_broadphase);
 #endif
 
-            SDL_Color color;
-            POLYGON* current = g_polygon_list.head;
-            POLYGON** polygon_arr = NULL; // pointer to pointer of array
-            int num_polygons = 0;
-            int *p_potential_collision_ids = NULL;
-            int num_potential_collisions = 0;
+            COLLISION_PAIR* pairs = NULL;
+            int num_pairs = 0;
 #ifdef ENABLE_PROFILING
             sweep_start_time = current_microseconds();
 #endif
-            if(current != NULL){
-                convert_list_to_arr(current, &polygon_arr, &num_polygons); // pass in addr of pointer to pointer of array
-                sort_arr(&polygon_arr, num_polygons); // pass in addr of array
-            }
-            sweep_and_prune(polygon_arr, num_polygons, &p_potential_collision_ids, &num_potential_collisions);
+#ifdef ENABLE_OPENCL
+            // the device finds its own pairs from the bodies it mirrors
+            if (!device_broadphase)
+#endif
+            broadphase_find_pairs(&g_broadphase, &g_frame_arena, &pairs, &num_pairs);
 #ifdef ENABLE_PROFILING
             sweep_end_time = current_microseconds();
             sweep_time = (sweep_end_time - sweep_start_time);
-            printf("time to sweep and prune %d polygons: %.4f us\n", num_polygons, sweep_time);
+            printf("time for broad phase over %d polygons into %d pairs: %.4f us\n", num_polygons, num_pairs, sweep_time);
 #endif
 
-#ifdef ENABLE_OPENCL
-#ifdef ENABLE_PROFILING
-            copy_start_time = current_microseconds();
-#endif
-            update_polygon_buffers(queue, p_potential_collision_ids, num_potential_collisions);
-#ifdef ENABLE_PROFILING
-            copy_end_time = current_microseconds();
-            copy_time = (copy_end_time - copy_start_time);
-            printf("time to update %d polygon buffers: %.4f us\n", num_polygons, copy_time);
-#endif
-#endif
 #ifdef ENABLE_PROFILING
             start_time = current_microseconds();
 #endif
-            while(current != NULL) {
-                POLYGON* current_next = current->next;
 #ifdef ENABLE_OPENCL
-                clSetKernelArg(kernel, 0, sizeof(cl_mem), &current->object_buffer);
-                clSetKernelArg(kernel, 1, sizeof(int), &current->vertices_idx);
-#endif
-                while(current_next != NULL && is_polygon_id_in_arr(p_potential_collision_ids, num_potential_collisions, current->id)) {
-                    colliding = 0;
-                    //printf("current id %d is in the array\n", current->id);
-#ifdef ENABLE_OPENCL
-                    size_t global_size[2] = {ALIGN_32(current->vertices_idx), ALIGN_32(current_next->vertices_idx)};
-                    size_t global_size_2[] = {ALIGN_32(current->vertices_idx) * ALIGN_32(current_next->vertices_idx)};
-                    int result_size[] = {current->vertices_idx * current_next->vertices_idx};
-                    clSetKernelArg(kernel, 2, sizeof(cl_mem), &current_next->object_buffer);
-                    clSetKernelArg(kernel, 3, sizeof(int), &current_next->vertices_idx);
-
-                    if(is_polygon_id_in_arr(p_potential_collision_ids, num_potential_collisions, current_next->id)){ 
+            // the device takes this frame's pairs while the previous frame's results are resolved and drawn,
+            // so collisions act a frame late and the device latency hides behind the cpu work
+            // with pairs from the host the device only takes its share, the cpu does the rest this frame
+            COLLISION_PAIR* device_pairs = NULL;
+            int* pairs_colliding = NULL;
+            int num_device_pairs = 0;
+            if (g_backend != BACKEND_NATIVE) {
+                if (device_broadphase) {
+                    cl_submit_device_collisions(&g_cl, &g_bodies, WINDOW_WIDTH, WINDOW_HEIGHT);
+                } else {
+                    num_device_pairs = scheduler_device_pairs(&g_scheduler, num_pairs);
+                    cl_submit_collisions(&g_cl, &g_bodies, pairs, num_device_pairs);
+                    pairs += num_device_pairs;
+                    num_pairs -= num_device_pairs;
+                }
 #ifdef ENABLE_PROFILING
-                        opencl_start_time = current_microseconds(); 
+                opencl_start_time = current_microseconds();
 #endif
-                        //printf("current_next id %d is in the array\n", current_next->id);
-                        status = clEnqueueNDRangeKernel(queue, kernel, 2, NULL, global_size, NULL, 0, NULL, NULL);
-                        if (status != CL_SUCCESS) {
-                            DBG_PRINT("Error enqueueing kernel: %d\n", status);
-                        }
-
-                        clSetKernelArg(kernel_2, 1, sizeof(int), &result_size);
-                        status = clEnqueueNDRangeKernel(queue, kernel_2, 1, NULL, &global_size_2, NULL, 0, NULL, NULL);
-                        if (status != CL_SUCCESS) {
-                            DBG_PRINT("Error enqueueing kernel_2: %d\n", status);
-                        }
-
-                        status = clEnqueueReadBuffer(queue, colliding_buffer, CL_TRUE, 0, sizeof(int), &colliding, 0, NULL, NULL);
-                        if(status != CL_SUCCESS) {
-                            printf("Error reading colliding buffer: %d\n", status);
-                        }
+                cl_collect_collisions(&g_cl, &device_pairs, &pairs_colliding, &num_device_pairs);
 #ifdef ENABLE_PROFILING
-                        opencl_end_time = current_microseconds(); 
-                        kernel_exe_time += (opencl_end_time - opencl_start_time);
+                opencl_end_time = current_microseconds();
+                kernel_exe_time = (opencl_end_time - opencl_start_time);
 #endif
-                    }
-
-                    if(colliding) {
+            }
 #else
-                    
-                    VECTOR result[current->vertices_idx*current_next->vertices_idx];
-                    memset(result, 0, sizeof(VECTOR) * current->vertices_idx*current_next->vertices_idx);
-                    colliding = is_polygon_id_in_arr(p_potential_collision_ids, num_potential_collisions, current_next->id);
-                    bool origin_in_polygon = false;
-                    if(colliding){ //potential collision, actually
-#ifdef ENABLE_PROFILING
-                        opencl_start_time = current_microseconds();
+            COLLISION_PAIR* device_pairs = NULL;
+            int num_device_pairs = 0;
+#endif
+#ifndef ENABLE_GOD_MODE
+            // every pair could hit the player
+            BODY_HANDLE* player_hits = (BODY_HANDLE*)arena_alloc(&g_frame_arena, (num_device_pairs + num_pairs + 1) * sizeof(BODY_HANDLE));
+            int num_player_hits = 0;
+#endif
+            // contacts are found on every core from where the bodies are now, then applied here in pair order
+            // so the result does not depend on which thread took which pair
+            NARROW_PHASE_JOB job = { device_pairs, num_device_pairs, pairs };
+#ifdef ENABLE_OPENCL
+            job.pairs_colliding = pairs_colliding;
 #endif
-                        calculate_minkowski_diff(current->vertices, current->vertices_idx, current_next->vertices, current_next->vertices_idx, result);
-                        origin_in_polygon = is_colliding(result, current->vertices_idx*current_next->vertices_idx);
+            long long pool_start_time = current_microseconds();
+            thread_pool_run(&g_thread_pool, narrow_phase_task, &job, num_device_pairs + num_pairs, NARROW_PHASE_CHUNK_SIZE);
+            double pool_time = current_microseconds() - pool_start_time;
 #ifdef ENABLE_PROFILING
-                        opencl_end_time = current_microseconds();
-                        kernel_exe_time += (opencl_end_time - opencl_start_time);
+            narrow_phase_time = pool_time;
 #endif
-                    }
-                    if(colliding && origin_in_polygon) {
+            // the threads time the cpu's own pairs and the epa runs for device results apart. their ratio splits
+            // the wall time of the run, which holds however many threads ended up with chunks
+            long long cpu_time = 0;
+            long long epa_time = 0;
+            for (int t = 0; t < g_thread_pool.num_threads; t++) {
+                cpu_time += g_contact_buffers[t].cpu_time;
+                epa_time += g_contact_buffers[t].epa_time;
+                g_contact_buffers[t].cpu_time = 0;
+                g_contact_buffers[t].epa_time = 0;
+            }
+            double cpu_share = 1.0;
+            if (cpu_time + epa_time > 0)
+                cpu_share = (double)cpu_time / (cpu_time + epa_time);
+            else if (num_pairs + num_device_pairs > 0) // too quick for the clock, go by pair counts
+                cpu_share = (double)num_pairs / (num_pairs + num_device_pairs);
+            scheduler_record_cpu(&g_scheduler, num_pairs, pool_time * cpu_share);
+#ifdef ENABLE_OPENCL
+            // a device hit still costs an epa run here, so that is part of what a device pair costs
+            if (g_backend != BACKEND_NATIVE && !device_broadphase)
+                scheduler_record_device(&g_scheduler, num_device_pairs, g_cl.device_time + pool_time * (1.0 - cpu_share));
 #endif
-                        // first vector of the resulting colliding polygons
-                        VECTOR overlap_vec = {current->vertices[0].x-current_next->vertices[0].x, 
-                                                current->vertices[0].y-current_next->vertices[0].y};
 
+            int num_contacts = 0;
+            PAIR_CONTACT* contacts = gather_contacts(&num_contacts);
+            num_contacts = drop_repeated_contacts(&job, contacts, num_contacts);
+            for(int i = 0; i < num_contacts; i++) {
+                COLLISION_PAIR* pair = job_pair(&job, contacts[i].pair);
+                // push both polygons apart along the contact normal so the overlap resolves in one step
+                separate_polygons(body_index(&g_bodies, pair->body1), body_index(&g_bodies, pair->body2), &contacts[i].contact);
 
-                        double separation_factor = 0.15;
-                        for(int i = 0; i < current->vertices_idx; i++) {
-                            current->vertices[i].x += overlap_vec.x * separation_factor;
-                            current->vertices[i].y += overlap_vec.y * separation_factor;
-                        }
-
-                        for(int i = 0; i < current_next->vertices_idx; i++) {
-                            current_next->vertices[i].x -= overlap_vec.x * separation_factor;
-                            current_next->vertices[i].y -= overlap_vec.y * separation_factor;
-                        }
-
-                        if(current_next->id == 0 ) {
+                if(same_body(pair->body1, g_player) || same_body(pair->body2, g_player)) {
 #ifndef ENABLE_GOD_MODE
-                            delete_polygon(&g_polygon_list, current);
-                            // lose a life
-                            if(hearts[2] != NULL) {
-                                hearts[2] = NULL;
-                            } else if(hearts[1] != NULL) {
-                                hearts[1] = NULL;
-                            } else if(hearts[0] != NULL) {
-                                hearts[0] = NULL;
-                            }
+                    // removed after the pair loop, later pairs may still reference it. one body costs one life
+                    BODY_HANDLE hit = same_body(pair->body1, g_player) ? pair->body2 : pair->body1;
+                    int seen = 0;
+                    for (int k = 0; k < num_player_hits && !seen; k++)
+                        seen = same_body(player_hits[k], hit);
+                    if (!seen)
+                        player_hits[num_player_hits++] = hit;
 #endif
-                        }
-                        break;
-                    }
-                        // printf("collision with id's %d %d\n", current->id, current_next->id);
-                    current_next = current_next->next;
                 }
+            }
+
+#ifndef ENABLE_GOD_MODE
+            for(int i = 0; i < num_player_hits; i++) {
+                broadphase_remove_body(&g_broadphase, player_hits[i]);
+                body_store_remove(&g_bodies, player_hits[i]);
+                // lose a life
+                if(hearts[2] != NULL) {
+                    hearts[2] = NULL;
+                } else if(hearts[1] != NULL) {
+                    hearts[1] = NULL;
+                } else if(hearts[0] != NULL) {
+                    hearts[0] = NULL;
+                }
+            }
+#endif
 
-                update_position(current);
-                draw_polygon(renderer, current->vertices, current->vertices_idx, SDL_WHITE);
-                current = current->next;
+            for(int i = 0; i < g_bodies.count; i++) {
+                update_position(i);
+                draw_polygon(renderer, g_bodies.shapes[i]->vertices, g_bodies.shapes[i]->vertices_idx, g_bodies.positions[i], SDL_WHITE);
             }
 #ifdef ENABLE_PROFILING
                 end_time = current_microseconds();
                 total_time = (end_time-start_time);
                 printf("elapsed time for num polygons %d: %.4f us\n", num_polygons, total_time);
                 printf("time to execute all kernels for num polygons %d: %.4f us\n", num_polygons, kernel_exe_time);
+                printf("time for the narrow phase on %d threads: %.4f us\n", g_thread_pool.num_threads, narrow_phase_time);
+#ifdef ENABLE_OPENCL
+                if (g_backend != BACKEND_NATIVE)
+                    printf("time on the device for the collected frame: %.4f us\n", g_cl.device_time);
+                if (g_backend != BACKEND_NATIVE && !device_broadphase)
+                    printf("device share %.2f, pair cost cpu %.3f us device %.3f us\n", g_scheduler.device_share, g_scheduler.cpu_pair_cost, g_scheduler.device_pair_cost);
+#endif
+#ifdef ENABLE_GJK
+                printf("gjk iterations for %d pairs: %d\n", g_gjk_pairs, g_gjk_iterations);
+                g_gjk_iterations = 0;
+                g_gjk_pairs = 0;
+#endif
 #endif
-                //print_polygon_list_details(&g_polygon_list);
+                //print_body_store_details(&g_bodies);
                 SDL_Rect menuRect = {725, 25, 50, 50}; 
                 SDL_RenderCopy(renderer, menu, NULL, &menuRect);
 
@@ -688,149 +663,253 @@ int main(int argc, char *argv[])
 Out:
     DBG_PRINT("Releasing resources...\n");
 #ifdef ENABLE_OPENCL
-    clFinish(queue);
-    clReleaseKernel(kernel);
-    clReleaseProgram(program);
-    clReleaseCommandQueue(queue);
-    clReleaseContext(g_context);
+    if (g_backend != BACKEND_NATIVE)
+        release_cl_narrowphase(&g_cl);
 #endif
+    if (g_thread_pool.num_threads > 0)
+        delete_thread_pool(&g_thread_pool);
+    for (int t = 0; t < THREAD_POOL_MAX_THREADS; t++)
+        free(g_contact_buffers[t].contacts);
     exit(-1);
 }
 
+// every body is one of these, built once around the origin
+static void create_shapes() {
+    create_arena(&g_shape_arena, ARENA_SLAB_SIZE);
+    create_box(&g_player_shape, &g_shape_arena, -RECTANGLE_WIDTH / 2, -RECTANGLE_HEIGHT / 2, RECTANGLE_WIDTH, RECTANGLE_HEIGHT);
+    create_circle(&g_circle_shape, &g_shape_arena, 0, 0, 20, MAX_VERTICES);
+#ifdef ENABLE_OPENCL
+    POLYGON* shapes[] = {&g_player_shape, &g_circle_shape};
+    if (g_backend != BACKEND_NATIVE)
+        cl_upload_shapes(&g_cl, shapes, ARRAY_SIZE(shapes));
+#endif
+}
+
 static void init_player() {
-    create_polygon(&g_player, 4);
+    VECTOR position = {100 + RECTANGLE_WIDTH / 2, 100 + RECTANGLE_HEIGHT / 2};
+    VECTOR velocity = {0, 0};
+    g_player = body_store_add(&g_bodies, &g_player_shape, position, velocity);
+}
 
-    add_vertice(&g_player, 100, 100); // top left
-    add_vertice(&g_player, 100 , 100 + RECTANGLE_HEIGHT); // bottom left
-    add_vertice(&g_player, 100 + RECTANGLE_WIDTH, 100 + RECTANGLE_HEIGHT); // bottom right
-    add_vertice(&g_player, 100 + RECTANGLE_WIDTH, 100); // bottom right
+static VECTOR* player_velocity() {
+    return &g_bodies.velocities[body_index(&g_bodies, g_player)];
+}
 
+static void spawn_circle(int center_x, int center_y, int velocity_y) {
+    VECTOR position = {center_x, center_y};
+    VECTOR velocity = {0, velocity_y};
+    broadphase_add_body(&g_broadphase, body_store_add(&g_bodies, &g_circle_shape, position, velocity));
 }
 
-static void draw_polygon(SDL_Renderer* renderer, VECTOR vertices[], int vertices_count, SDL_Color color) {
+static void draw_polygon(SDL_Renderer* renderer, VECTOR vertices[], int vertices_count, VECTOR position, SDL_Color color) {
     int i;
     SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
 
     for (i = 0; i < vertices_count - 1; i++) {
         SDL_RenderDrawLine(renderer, 
-                            (int)vertices[i].x,
-                            (int)vertices[i].y,
-                            (int)vertices[i + 1].x, 
-                            (int)vertices[i + 1].y);                    
+                            position.x + vertices[i].x,
+                            position.y + vertices[i].y,
+                            position.x + vertices[i + 1].x, 
+                            position.y + vertices[i + 1].y);                    
     }
     SDL_RenderDrawLine(renderer, 
-                        (int)vertices[i].x, 
-                        (int)vertices[i].y,
-                        (int)vertices[0].x, 
-                        (int)vertices[0].y);
+                        position.x + vertices[i].x, 
+                        position.y + vertices[i].y,
+                        position.x + vertices[0].x, 
+                        position.y + vertices[0].y);
 }
 
-static void update_position(POLYGON* polygon) {
+static void update_position(int index) {
 
     int x_wrap = 0, y_wrap = 0;
-    double min_x = polygon->vertices[0].x;
-    double min_y = polygon->vertices[0].y;
-    double max_x = polygon->vertices[0].x;
-    double max_y = polygon->vertices[0].y;
-
-    for (int i = 0; i < polygon->vertices_idx; i++) {
-        min_x = fmin(min_x, polygon->vertices[i].x);
-        min_y = fmin(min_y, polygon->vertices[i].y);
-        max_x = fmax(max_x, polygon->vertices[i].x);
-        max_y = fmax(max_y, polygon->vertices[i].y);
-    }
+    AABB* aabb = &g_bodies.aabbs[index];
+    VECTOR* velocity = &g_bodies.velocities[index];
 
-    if (min_x < 0.0)
+    if (aabb->min.x < 0)
         x_wrap = WINDOW_WIDTH;
-    if (max_x >= WINDOW_WIDTH)
+    if (aabb->max.x >= WINDOW_WIDTH)
         x_wrap = -WINDOW_WIDTH;
-    if (min_y < 0.0)
+    if (aabb->min.y < 0)
         y_wrap = WINDOW_HEIGHT;
-    if (max_y >= WINDOW_HEIGHT)
+    if (aabb->max.y >= WINDOW_HEIGHT)
         y_wrap = -WINDOW_HEIGHT;
 
-    for (int i = 0; i < polygon->vertices_idx; i++) {
-        polygon->vertices[i].x += polygon->velocity.x + x_wrap;
-        polygon->vertices[i].y += polygon->velocity.y + y_wrap;
-    }
+    translate_body(&g_bodies, index, velocity->x + x_wrap, velocity->y + y_wrap);
+}
+
+static void separate_polygons(int index1, int index2, CONTACT* contact) {
+    // each polygon moves half the depth, the extra pixel covers rounding to integer vertices
+    double distance = contact->depth / 2 + 1;
+    int dx = (int)lround(contact->normal_x * distance);
+    int dy = (int)lround(contact->normal_y * distance);
 
+    translate_body(&g_bodies, index1, -dx, -dy);
+    translate_body(&g_bodies, index2, dx, dy);
 }
 
-static void sort_arr(POLYGON*** p_arr, int polygon_count){ // takes in pointer to arr
-    for (int i = 0; i < polygon_count - 1; i++) {
-        for (int j = 0; j < polygon_count - i - 1; j++) {
-            double min_x_1 = (*p_arr)[j]->vertices[0].x;
-            double min_x_2 = (*p_arr)[j+1]->vertices[0].x;
-            for (int k = 0; k < (*p_arr)[j]->vertices_idx; k++) {
-                min_x_1 = fmin(min_x_1, (*p_arr)[j]->vertices[k].x);
-            }
-            for (int k = 0; k < (*p_arr)[j+1]->vertices_idx; k++) {
-                min_x_2 = fmin(min_x_2, (*p_arr)[j+1]->vertices[k].x);
-            }
+// shapes are tested in the first body's local space, the pair offset carries the second one across a seam
+static VECTOR pair_offset(int index1, int index2, COLLISION_PAIR* pair) {
+    VECTOR offset = {
+        g_bodies.positions[index2].x - g_bodies.positions[index1].x + pair->offset.x,
+        g_bodies.positions[index2].y - g_bodies.positions[index1].y + pair->offset.y
+    };
+    return offset;
+}
 
-            if (min_x_1 > min_x_2) {
-                POLYGON* temp = (*p_arr)[j];
-                (*p_arr)[j] = (*p_arr)[j + 1];
-                (*p_arr)[j + 1] = temp;
-            }
+static int parse_backend(const char* name, COMPUTE_BACKEND* p_backend) {
+    for (int i = 0; i < ARRAY_SIZE(backend_names); i++) {
+        if (strcmp(name, backend_names[i]) == 0) {
+            *p_backend = (COMPUTE_BACKEND)i;
+            return 1;
         }
     }
+    return 0;
 }
 
-static void sweep_and_prune(POLYGON** p_arr, int num_polygons, int *p_collision_ids[], int *p_num_collisions){
-    int *collision_arr = NULL;
-    int collision_idx = 0;
-    for(int i=0; i< num_polygons - 1; i++) {
-        double max_x_i = p_arr[i]->vertices[0].x;
-        for (int k = 0; k < p_arr[i]->vertices_idx; k++) {
-            max_x_i = fmax(max_x_i, p_arr[i]->vertices[k].x);
-        }
+// brings up the requested opencl device, or with auto the gpu and then the cpu one. anything that fails
+// falls back to the native narrow phase, so the game runs without any opencl device.
+// auto goes by this fixed order rather than timing each backend: no bodies exist yet to time it on,
+// and the pair scheduler moves work to the cpu threads anyway when the chosen device turns out slow
+static COMPUTE_BACKEND init_backend(COMPUTE_BACKEND requested) {
+#ifdef ENABLE_OPENCL
+    COMPUTE_BACKEND candidates[] = { BACKEND_GPU, BACKEND_CPU };
+    cl_device_type device_types[] = { CL_DEVICE_TYPE_GPU, CL_DEVICE_TYPE_CPU };
+
+    for (int i = 0; i < ARRAY_SIZE(candidates); i++) {
+        if (requested != BACKEND_AUTO && requested != candidates[i])
+            continue;
+        if (create_cl_narrowphase(&g_cl, device_types[i]) == CL_SUCCESS)
+            return candidates[i];
+        release_cl_narrowphase(&g_cl);
+        DBG_PRINT("No usable OpenCL %s device\n", backend_names[candidates[i]]);
+    }
+#else
+    if (requested != BACKEND_AUTO && requested != BACKEND_NATIVE)
+        printf("Built without OpenCL, ignoring the %s backend\n", backend_names[requested]);
+#endif
+    return BACKEND_NATIVE;
+}
 
-        for(int j=i+1; j< num_polygons; j++){
-            double min_x_j = p_arr[j]->vertices[0].x;
-            for (int k =0; k <p_arr[j]->vertices_idx; k++) {
-                min_x_j = fmin(min_x_j, p_arr[j]->vertices[k].x);
-            }
-            if(min_x_j> max_x_i)
-                break;
+static COLLISION_PAIR* job_pair(NARROW_PHASE_JOB* job, int i) {
+    return (i < job->num_device_pairs) ? &job->device_pairs[i] : &job->pairs[i - job->num_device_pairs];
+}
 
-            if (!is_polygon_id_in_arr(collision_arr, collision_idx, p_arr[i]->id)) {
-                collision_arr = (int*)realloc(collision_arr, (collision_idx + 1) * sizeof(int));
-                collision_arr[collision_idx++] = p_arr[i]->id;
-            }
+// runs on any thread of the pool. bodies are only read here, every contact goes to the thread's own buffer
+static void narrow_phase_task(void* context, int begin, int end, int thread) {
+    NARROW_PHASE_JOB* job = (NARROW_PHASE_JOB*)context;
+    CONTACT_BUFFER* buffer = &g_contact_buffers[thread];
+    // a chunk can straddle the device results and the cpu's pairs, the two are timed apart
+    int split = (job->num_device_pairs > begin) ? job->num_device_pairs : begin;
+    if (split > end)
+        split = end;
+
+    long long start_time = current_microseconds();
+    find_contacts(job, buffer, begin, split);
+    long long split_time = current_microseconds();
+    find_contacts(job, buffer, split, end);
+    buffer->epa_time += split_time - start_time;
+    buffer->cpu_time += current_microseconds() - split_time;
+}
 
-            if (!is_polygon_id_in_arr(collision_arr, collision_idx, p_arr[j]->id)) {
-                collision_arr = (int*)realloc(collision_arr, (collision_idx + 1) * sizeof(int));
-                collision_arr[collision_idx++] = p_arr[j]->id;
-            }
+static void find_contacts(NARROW_PHASE_JOB* job, CONTACT_BUFFER* buffer, int begin, int end) {
+    for (int i = begin; i < end; i++) {
+        COLLISION_PAIR* pair = job_pair(job, i);
+        int index1 = body_index(&g_bodies, pair->body1);
+        int index2 = body_index(&g_bodies, pair->body2);
+        // pairs from the previous frame can name bodies removed since
+        if (index1 < 0 || index2 < 0)
+            continue;
+        POLYGON* polygon1 = g_bodies.shapes[index1];
+        POLYGON* polygon2 = g_bodies.shapes[index2];
+        VECTOR offset = pair_offset(index1, index2, pair);
+        CONTACT contact;
+        int colliding;
 
+#ifdef ENABLE_OPENCL
+        if (i < job->num_device_pairs) {
+            // the device only says whether they overlap, epa finds the contact
+            colliding = job->pairs_colliding[i] && epa_penetration(polygon1->vertices, polygon1->vertices_idx, polygon2->vertices, polygon2->vertices_idx, offset, &contact);
+        } else
+#endif
+        {
+            colliding = detect_collision(polygon1, polygon2, offset, &contact);
         }
+        if (!colliding)
+            continue;
+
+        if (buffer->count == buffer->capacity) {
+            buffer->capacity = (buffer->capacity > 0) ? buffer->capacity * 2 : NARROW_PHASE_CHUNK_SIZE;
+            buffer->contacts = (PAIR_CONTACT*)realloc(buffer->contacts, buffer->capacity * sizeof(PAIR_CONTACT));
+        }
+        buffer->contacts[buffer->count].pair = i;
+        buffer->contacts[buffer->count].contact = contact;
+        buffer->count++;
     }
-    
-    *p_num_collisions = collision_idx;
-    *p_collision_ids = collision_arr;
 }
 
-#ifdef ENABLE_OPENCL
-static void update_polygon_buffers(cl_command_queue queue, int p_collision_ids[], int num_collisions) {
-    int status = 0;
-    POLYGON* current = g_polygon_list.head;
-    cl_event map_event, unmap_event;
-    while(current != NULL) {
-        if(is_polygon_id_in_arr(p_collision_ids, num_collisions, current->id)){
-            VECTOR* mapped_buffer = (VECTOR*)clEnqueueMapBuffer(queue, current->object_buffer, CL_TRUE, CL_MAP_WRITE, 0, sizeof(VECTOR) * current->vertices_idx, 0, NULL, &map_event, &status);
-            if (status != CL_SUCCESS) {
-                DBG_PRINT("Error polygon ID %d clEnqueueMapBuffer: %d\n", current->id, status);
-            }
-            memcpy(mapped_buffer, current->vertices, sizeof(VECTOR)* current->vertices_idx);
-            status = clEnqueueUnmapMemObject(queue, current->object_buffer, mapped_buffer, 0, NULL, &unmap_event);
-            if (status != CL_SUCCESS) {
-                DBG_PRINT("Error polygon ID %d clEnqueueUnmapMemObject: %d\n", current->id, status);
-            }
-        }
-        current = current->next;
+static int compare_contacts(const void* a, const void* b) {
+    return ((const PAIR_CONTACT*)a)->pair - ((const PAIR_CONTACT*)b)->pair;
+}
+
+// empties every thread's buffer into one array from the frame arena, sorted by pair
+static PAIR_CONTACT* gather_contacts(int* p_num_contacts) {
+    int num_contacts = 0;
+    for (int t = 0; t < g_thread_pool.num_threads; t++)
+        num_contacts += g_contact_buffers[t].count;
+
+    PAIR_CONTACT* contacts = (PAIR_CONTACT*)arena_alloc(&g_frame_arena, (num_contacts + 1) * sizeof(PAIR_CONTACT));
+    num_contacts = 0;
+    for (int t = 0; t < g_thread_pool.num_threads; t++) {
+        memcpy(&contacts[num_contacts], g_contact_buffers[t].contacts, g_contact_buffers[t].count * sizeof(PAIR_CONTACT));
+        num_contacts += g_contact_buffers[t].count;
+        g_contact_buffers[t].count = 0;
+    }
+    qsort(contacts, num_contacts, sizeof(PAIR_CONTACT), compare_contacts);
+
+    *p_num_contacts = num_contacts;
+    return contacts;
+}
+
+static int compare_keys(const void* a, const void* b) {
+    long long key1 = *(const long long*)a, key2 = *(const long long*)b;
+    return (key1 > key2) - (key1 < key2);
+}
+
+// a body pair as one number, from dense indices that stay put until the contacts are applied
+static long long contact_key(NARROW_PHASE_JOB* job, PAIR_CONTACT* contact) {
+    COLLISION_PAIR* pair = job_pair(job, contact->pair);
+    int index1 = body_index(&g_bodies, pair->body1);
+    int index2 = body_index(&g_bodies, pair->body2);
+    if (index1 > index2) {
+        int temp = index1;
+        index1 = index2;
+        index2 = temp;
     }
-    return;
+    return (long long)index1 * g_bodies.count + index2;
 }
 
-#endif
+// the device results are a frame old and the split moves every frame, so the cpu's pairs can repeat a body
+// pair the device found colliding. both contacts come from the same positions, so only the device one is kept
+static int drop_repeated_contacts(NARROW_PHASE_JOB* job, PAIR_CONTACT contacts[], int num_contacts) {
+    int num_device_contacts = 0;
+    int kept;
+
+    // sorted by pair, so the device contacts come first
+    while (num_device_contacts < num_contacts && contacts[num_device_contacts].pair < job->num_device_pairs)
+        num_device_contacts++;
+    if (num_device_contacts == 0 || num_device_contacts == num_contacts)
+        return num_contacts;
+
+    long long* device_keys = (long long*)arena_alloc(&g_frame_arena, num_device_contacts * sizeof(long long));
+    for (int i = 0; i < num_device_contacts; i++)
+        device_keys[i] = contact_key(job, &contacts[i]);
+    qsort(device_keys, num_device_contacts, sizeof(long long), compare_keys);
+
+    kept = num_device_contacts;
+    for (int i = num_device_contacts; i < num_contacts; i++) {
+        long long key = contact_key(job, &contacts[i]);
+        if (bsearch(&key, device_keys, num_device_contacts, sizeof(long long), compare_keys) == NULL)
+            contacts[kept++] = contacts[i];
+    }
+    return kept;
+}
@@ -0,0 +1,961 @@
+#ifdef ENABLE_OPENCL
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "narrowphase_cl.h"
+#include "utils.h"
+
+static const char *find_collisions_kernel_str =
+    "typedef struct {\n"
+    "    int x;\n"
+    "    int y;\n"
+    "} VECTOR;\n"
+
+    "typedef struct {\n"
+    "    int body1;\n"
+    "    int body2;\n"
+    "    int offset_x;\n"
+    "    int offset_y;\n"
+    "} CL_PAIR;\n"
+
+    "typedef struct {\n"
+    "    VECTOR min;\n"
+    "    VECTOR max;\n"
+    "} AABB;\n"
+
+    "typedef struct {\n"
+    "    int vertices_offset;\n"
+    "    int vertices_count;\n"
+    "    AABB aabb;\n"
+    "} CL_BODY_SHAPE;\n"
+
+    "int orientation(__local const VECTOR* set, const int set_size) {\n"
+    "    long area = 0;\n"
+    "    for (int i = 0; i < set_size; i++) {\n"
+    "        VECTOR v1 = set[i];\n"
+    "        VECTOR v2 = set[(i + 1) % set_size];\n"
+    "        area += (long)v1.x * v2.y - (long)v1.y * v2.x;\n"
+    "    }\n"
+    "    return (area < 0) ? -1 : 1;\n"
+    "}\n"
+
+    "int walk_index(int start, int k, int direction, int set_size) {\n"
+    "    return ((start + direction * k) % set_size + set_size) % set_size;\n"
+    "}\n"
+
+    // edges are ordered by their angle from +x in [0, 2pi), the half plane splits the circle so a cross product can compare them
+    "int angle_less(VECTOR u, VECTOR v) {\n"
+    "    int half_u = (u.y < 0 || (u.y == 0 && u.x < 0));\n"
+    "    int half_v = (v.y < 0 || (v.y == 0 && v.x < 0));\n"
+    "    if (half_u != half_v)\n"
+    "        return half_u < half_v;\n"
+    "    return (long)u.x * v.y - (long)u.y * v.x > 0;\n"
+    "}\n"
+
+    // edge k of set1, and of -set2 which walks set2 the other way round
+    "VECTOR edge1(__local const VECTOR* walk, int size, int k) {\n"
+    "    VECTOR p1 = walk[k], p2 = walk[(k + 1) % size], edge;\n"
+    "    edge.x = p2.x - p1.x;\n"
+    "    edge.y = p2.y - p1.y;\n"
+    "    return edge;\n"
+    "}\n"
+
+    "VECTOR edge2(__local const VECTOR* walk, int size, int k) {\n"
+    "    VECTOR q1 = walk[k], q2 = walk[(k + 1) % size], edge;\n"
+    "    edge.x = q1.x - q2.x;\n"
+    "    edge.y = q1.y - q2.y;\n"
+    "    return edge;\n"
+    "}\n"
+
+    // walks start at the lowest point, so edge angles never shrink along them and can be binary searched.
+    // returns the number of edges of the walk that come before edge, or also those parallel to it with inclusive
+    "int edges_before(__local const VECTOR* walk, int size, int negated, VECTOR edge, int inclusive) {\n"
+    "    int low = 0, high = size;\n"
+    "    while (low < high) {\n"
+    "        int middle = (low + high) / 2;\n"
+    "        VECTOR other = negated ? edge2(walk, size, middle) : edge1(walk, size, middle);\n"
+    "        if (inclusive ? !angle_less(edge, other) : angle_less(other, edge))\n"
+    "            low = middle + 1;\n"
+    "        else\n"
+    "            high = middle;\n"
+    "    }\n"
+    "    return low;\n"
+    "}\n"
+
+    "int crosses_ray(VECTOR p1, VECTOR p2) {\n"
+    "    return (0 < p1.y) != (0 < p2.y) && 0 < p1.x + ((float)(-p1.y) / (p2.y - p1.y)) * (p2.x - p1.x);\n"
+    "}\n"
+
+    // one work-group per pair. both shapes are staged in local memory, then every work-item places its edges of
+    // set1 - (set2 + offset) in the hull by binary searching the other shape, which is where the sequential edge merge
+    // would put them, and tests them against the ray from the origin along +x. the crossings are summed in local
+    // memory and an odd count means the origin is inside, so the shapes overlap. the pair count is read from the
+    // device, where the broad phase may have left it, and colliding pairs are also appended to hits
+    "__kernel __attribute__((reqd_work_group_size(PAIR_GROUP_SIZE, 1, 1)))\n"
+    "void find_collisions(__global const VECTOR* vertices, __global const CL_BODY_SHAPE* body_shapes, __global const VECTOR* positions,\n"
+    "                     __global const CL_PAIR* pairs, __global int* counts, const int pairs_capacity, __global int* colliding,\n"
+    "                     __global CL_PAIR* hits, const int hits_capacity) {\n"
+    "    __local VECTOR set1[MAX_VERTICES], set2[MAX_VERTICES];\n"
+    "    __local VECTOR walk1[MAX_VERTICES], walk2[MAX_VERTICES];\n"
+    "    __local int crossings[PAIR_GROUP_SIZE];\n"
+    "    __local int start1, start2, dir1, dir2;\n"
+    "    int id = get_group_id(0);\n"
+    "    int local_id = get_local_id(0);\n"
+    "    if (id >= min(counts[0], pairs_capacity))\n"
+    "        return;\n"
+    "\n"
+    "    CL_PAIR pair = pairs[id];\n"
+    "    CL_BODY_SHAPE shape1 = body_shapes[pair.body1];\n"
+    "    CL_BODY_SHAPE shape2 = body_shapes[pair.body2];\n"
+    "    int set1_size = shape1.vertices_count;\n"
+    "    int set2_size = shape2.vertices_count;\n"
+    "    // set2 is placed relative to set1 like in the cpu narrow phase\n"
+    "    int offset_x = positions[pair.body2].x - positions[pair.body1].x + pair.offset_x;\n"
+    "    int offset_y = positions[pair.body2].y - positions[pair.body1].y + pair.offset_y;\n"
+    "    for (int k = local_id; k < set1_size; k += PAIR_GROUP_SIZE)\n"
+    "        set1[k] = vertices[shape1.vertices_offset + k];\n"
+    "    for (int k = local_id; k < set2_size; k += PAIR_GROUP_SIZE)\n"
+    "        set2[k] = vertices[shape2.vertices_offset + k];\n"
+    "    barrier(CLK_LOCAL_MEM_FENCE);\n"
+    "\n"
+    "    // set1 starts at its lowest point and -set2 at its lowest point, the highest point of set2\n"
+    "    if (local_id == 0) {\n"
+    "        int i, j;\n"
+    "        dir1 = orientation(set1, set1_size);\n"
+    "        dir2 = orientation(set2, set2_size);\n"
+    "        for (i = 1, start1 = 0; i < set1_size; i++) {\n"
+    "            if (set1[i].y < set1[start1].y || (set1[i].y == set1[start1].y && set1[i].x < set1[start1].x))\n"
+    "                start1 = i;\n"
+    "        }\n"
+    "        for (j = 1, start2 = 0; j < set2_size; j++) {\n"
+    "            if (set2[j].y > set2[start2].y || (set2[j].y == set2[start2].y && set2[j].x > set2[start2].x))\n"
+    "                start2 = j;\n"
+    "        }\n"
+    "    }\n"
+    "    barrier(CLK_LOCAL_MEM_FENCE);\n"
+    "\n"
+    "    for (int k = local_id; k < set1_size; k += PAIR_GROUP_SIZE)\n"
+    "        walk1[k] = set1[walk_index(start1, k, dir1, set1_size)];\n"
+    "    for (int k = local_id; k < set2_size; k += PAIR_GROUP_SIZE)\n"
+    "        walk2[k] = set2[walk_index(start2, k, dir2, set2_size)];\n"
+    "    barrier(CLK_LOCAL_MEM_FENCE);\n"
+    "\n"
+    // runs of parallel edges are merged pairwise like the sequential merge does, the k'th edge of a run in set1
+    // steps together with the k'th of the run in -set2 and the longer run finishes alone. a merged step is owned by set1
+    "    int counter = 0;\n"
+    "    for (int e = local_id; e < set1_size + set2_size; e += PAIR_GROUP_SIZE) {\n"
+    "        VECTOR edge, start, end;\n"
+    "        int i, j;\n"
+    "        if (e < set1_size) {\n"
+    "            i = e;\n"
+    "            edge = edge1(walk1, set1_size, i);\n"
+    "            int run = i - edges_before(walk1, set1_size, 0, edge, 0);\n"
+    "            int before = edges_before(walk2, set2_size, 1, edge, 0);\n"
+    "            int parallel = edges_before(walk2, set2_size, 1, edge, 1) - before;\n"
+    "            if (run < parallel) {\n"
+    "                VECTOR other = edge2(walk2, set2_size, before + run);\n"
+    "                edge.x += other.x;\n"
+    "                edge.y += other.y;\n"
+    "                j = before + run;\n"
+    "            } else {\n"
+    "                j = before + parallel;\n"
+    "            }\n"
+    "        } else {\n"
+    "            j = e - set1_size;\n"
+    "            edge = edge2(walk2, set2_size, j);\n"
+    "            int run = j - edges_before(walk2, set2_size, 1, edge, 0);\n"
+    "            int before = edges_before(walk1, set1_size, 0, edge, 0);\n"
+    "            int parallel = edges_before(walk1, set1_size, 0, edge, 1) - before;\n"
+    "            if (run < parallel)\n"
+    "                continue;\n"
+    "            i = before + parallel;\n"
+    "        }\n"
+    "\n"
+    "        start.x = walk1[i % set1_size].x - walk2[j % set2_size].x - offset_x;\n"
+    "        start.y = walk1[i % set1_size].y - walk2[j % set2_size].y - offset_y;\n"
+    "        end.x = start.x + edge.x;\n"
+    "        end.y = start.y + edge.y;\n"
+    "        counter += crosses_ray(start, end);\n"
+    "    }\n"
+    "\n"
+    "    crossings[local_id] = counter;\n"
+    "    barrier(CLK_LOCAL_MEM_FENCE);\n"
+    "    for (int stride = PAIR_GROUP_SIZE / 2; stride > 0; stride /= 2) {\n"
+    "        if (local_id < stride)\n"
+    "            crossings[local_id] += crossings[local_id + stride];\n"
+    "        barrier(CLK_LOCAL_MEM_FENCE);\n"
+    "    }\n"
+    "\n"
+    "    if (local_id == 0) {\n"
+    "        colliding[id] = (crossings[0] % 2 == 1);\n"
+    "        if (colliding[id]) {\n"
+    "            int hit = atomic_inc(&counts[1]);\n"
+    "            if (hit < hits_capacity)\n"
+    "                hits[hit] = pair;\n"
+    "        }\n"
+    "    }\n"
+    "}\n";
+
+// the broad phase on the device, ahead of find_collisions in the same program. it mirrors the sweep and prune of
+// broadphase.c: sort the bodies by min x, sweep forward from every body, then sweep ghosts of the bodies reaching
+// past the right seam against the left edge. pairs are appended through a counter so no host round trip is needed
+static const char *broadphase_kernel_str =
+    // keys past the last body sort to the end of the padded range
+    "__kernel void compute_aabbs(__global const CL_BODY_SHAPE* body_shapes, __global const VECTOR* positions, const int num_bodies,\n"
+    "                            __global AABB* aabbs, __global int2* keys) {\n"
+    "    int id = get_global_id(0);\n"
+    "    if (id >= num_bodies) {\n"
+    "        keys[id].x = INT_MAX;\n"
+    "        keys[id].y = -1;\n"
+    "        return;\n"
+    "    }\n"
+    "\n"
+    "    AABB aabb = body_shapes[id].aabb;\n"
+    "    VECTOR position = positions[id];\n"
+    "    aabb.min.x += position.x;\n"
+    "    aabb.min.y += position.y;\n"
+    "    aabb.max.x += position.x;\n"
+    "    aabb.max.y += position.y;\n"
+    "    aabbs[id] = aabb;\n"
+    "    keys[id].x = aabb.min.x;\n"
+    "    keys[id].y = id;\n"
+    "}\n"
+
+    // one compare and swap step of a bitonic sort over a power of two keys, ties broken by index so the order is stable
+    "__kernel void bitonic_sort_step(__global int2* keys, const int j, const int k) {\n"
+    "    int i = get_global_id(0);\n"
+    "    int partner = i ^ j;\n"
+    "    if (partner <= i)\n"
+    "        return;\n"
+    "\n"
+    "    int2 a = keys[i];\n"
+    "    int2 b = keys[partner];\n"
+    "    int greater = (a.x > b.x || (a.x == b.x && a.y > b.y));\n"
+    "    if (greater == ((i & k) == 0)) {\n"
+    "        keys[i] = b;\n"
+    "        keys[partner] = a;\n"
+    "    }\n"
+    "}\n"
+
+    "int wrapped_overlap(int min1, int max1, int min2, int max2, int period, int* p_offset) {\n"
+    "    int shifts[3] = { 0, period, -period };\n"
+    "    for (int i = 0; i < 3; i++) {\n"
+    "        if (min1 <= max2 + shifts[i] && min2 + shifts[i] <= max1) {\n"
+    "            *p_offset = shifts[i];\n"
+    "            return 1;\n"
+    "        }\n"
+    "    }\n"
+    "    return 0;\n"
+    "}\n"
+
+    "void add_pair(__global CL_PAIR* pairs, __global int* counts, int pairs_capacity, int body1, int body2, int offset_x, int offset_y) {\n"
+    "    int slot = atomic_inc(&counts[0]);\n"
+    "    if (slot >= pairs_capacity)\n"
+    "        return;\n"
+    "    pairs[slot].body1 = body1;\n"
+    "    pairs[slot].body2 = body2;\n"
+    "    pairs[slot].offset_x = offset_x;\n"
+    "    pairs[slot].offset_y = offset_y;\n"
+    "}\n"
+
+    // one work-item per sorted body
+    "__kernel void sweep_pairs(__global const int2* keys, __global const AABB* aabbs, const int num_bodies, const int world_width,\n"
+    "                          const int world_height, __global CL_PAIR* pairs, __global int* counts, const int pairs_capacity) {\n"
+    "    int rank = get_global_id(0);\n"
+    "    int offset_y;\n"
+    "    if (rank >= num_bodies)\n"
+    "        return;\n"
+    "\n"
+    "    int i = keys[rank].y;\n"
+    "    AABB aabb_i = aabbs[i];\n"
+    "    for (int r = rank + 1; r < num_bodies && keys[r].x <= aabb_i.max.x; r++) {\n"
+    "        AABB aabb_j = aabbs[keys[r].y];\n"
+    "        if (wrapped_overlap(aabb_i.min.y, aabb_i.max.y, aabb_j.min.y, aabb_j.max.y, world_height, &offset_y))\n"
+    "            add_pair(pairs, counts, pairs_capacity, i, keys[r].y, 0, offset_y);\n"
+    "    }\n"
+    "\n"
+    "    int ghost_min_x = aabb_i.min.x - world_width;\n"
+    "    int ghost_max_x = aabb_i.max.x - world_width;\n"
+    "    for (int r = 0; r < num_bodies && keys[r].x <= ghost_max_x; r++) {\n"
+    "        AABB aabb_j = aabbs[keys[r].y];\n"
+    "        if (r == rank || aabb_j.max.x < ghost_min_x)\n"
+    "            continue;\n"
+    "        if (wrapped_overlap(aabb_i.min.y, aabb_i.max.y, aabb_j.min.y, aabb_j.max.y, world_height, &offset_y))\n"
+    "            add_pair(pairs, counts, pairs_capacity, i, keys[r].y, world_width, offset_y);\n"
+    "    }\n"
+    "}\n";
+
+static unsigned int fnv1a(unsigned int hash, const char* data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// a binary only fits the device and driver that built it, from the same source and options
+static void program_cache_key(CL_NARROWPHASE* narrowphase, const char* sources[], int num_sources, const char* options, char* key) {
+    char device_name[256] = "";
+    char driver_version[64] = "";
+    unsigned int hash = 2166136261u;
+
+    clGetDeviceInfo(narrowphase->device, CL_DEVICE_NAME, sizeof(device_name), device_name, NULL);
+    clGetDeviceInfo(narrowphase->device, CL_DRIVER_VERSION, sizeof(driver_version), driver_version, NULL);
+    for (int i = 0; i < num_sources; i++)
+        hash = fnv1a(hash, sources[i], strlen(sources[i]));
+    hash = fnv1a(hash, options, strlen(options));
+    snprintf(key, CL_CACHE_KEY_SIZE, "%s;%s;%08x", device_name, driver_version, hash);
+}
+
+// the cache file holds the key on its own line, then the binary size and the binary. anything that does not
+// match or does not build is treated as a miss, and the source build overwrites it
+static cl_program load_cached_program(CL_NARROWPHASE* narrowphase, const char* key, const char* options) {
+    int status;
+    cl_int binary_status;
+    char cached_key[CL_CACHE_KEY_SIZE];
+    size_t size = 0;
+    unsigned char* binary = NULL;
+    cl_program program = NULL;
+    FILE* file = fopen(CL_CACHE_FILE, "rb");
+
+    if (file == NULL)
+        return NULL;
+    if (fgets(cached_key, sizeof(cached_key), file) == NULL || strncmp(cached_key, key, strlen(key)) != 0 || cached_key[strlen(key)] != '\n')
+        goto Out;
+    if (fread(&size, sizeof(size), 1, file) != 1 || size == 0 || size > CL_CACHE_MAX_BINARY_SIZE)
+        goto Out;
+    binary = (unsigned char*)malloc(size);
+    if (fread(binary, 1, size, file) != size)
+        goto Out;
+
+    program = clCreateProgramWithBinary(narrowphase->context, 1, &narrowphase->device, &size, (const unsigned char**)&binary, &binary_status, &status);
+    if (status == CL_SUCCESS && binary_status == CL_SUCCESS)
+        status = clBuildProgram(program, 1, &narrowphase->device, options, NULL, NULL);
+    if (status != CL_SUCCESS || binary_status != CL_SUCCESS) {
+        DBG_PRINT("Ignoring cached OpenCL program: %d %d\n", status, binary_status);
+        if (program)
+            clReleaseProgram(program);
+        program = NULL;
+    }
+
+Out:
+    free(binary);
+    fclose(file);
+    return program;
+}
+
+static void save_program_binary(CL_NARROWPHASE* narrowphase, const char* key) {
+    size_t size = 0;
+    unsigned char* binary;
+    FILE* file;
+
+    if (clGetProgramInfo(narrowphase->program, CL_PROGRAM_BINARY_SIZES, sizeof(size), &size, NULL) != CL_SUCCESS || size == 0)
+        return;
+    binary = (unsigned char*)malloc(size);
+    if (clGetProgramInfo(narrowphase->program, CL_PROGRAM_BINARIES, sizeof(binary), &binary, NULL) == CL_SUCCESS) {
+        file = fopen(CL_CACHE_FILE, "wb");
+        if (file) {
+            fprintf(file, "%s\n", key);
+            fwrite(&size, sizeof(size), 1, file);
+            fwrite(binary, 1, size, file);
+            fclose(file);
+        }
+    }
+    free(binary);
+}
+
+// takes the first device of the given type on any platform
+int create_cl_narrowphase(CL_NARROWPHASE* narrowphase, cl_device_type device_type) {
+    int status;
+    cl_platform_id platforms[CL_MAX_PLATFORMS];
+    cl_uint num_platforms = 0;
+    memset(narrowphase, 0, sizeof(CL_NARROWPHASE));
+    narrowphase->uploaded_layout = -1;
+    narrowphase->device_pairs_last = -1;
+    narrowphase->device_hits_last = -1;
+
+    DBG_PRINT("Getting OpenCL platform IDs...\n");
+    status = clGetPlatformIDs(CL_MAX_PLATFORMS, platforms, &num_platforms);
+    if (status != CL_SUCCESS) {
+        printf("Error getting platform ID: %d\n", status);
+        return status;
+    }
+    // the count is of all platforms, not just the ones that fit
+    if (num_platforms > CL_MAX_PLATFORMS)
+        num_platforms = CL_MAX_PLATFORMS;
+
+    DBG_PRINT("Getting OpenCL device IDs...\n");
+    status = CL_DEVICE_NOT_FOUND;
+    for (cl_uint i = 0; i < num_platforms && status != CL_SUCCESS; i++) {
+        status = clGetDeviceIDs(platforms[i], device_type, 1, &narrowphase->device, NULL);
+        narrowphase->platform = platforms[i];
+    }
+    if (status != CL_SUCCESS) {
+        printf("Error getting device ID: %d\n", status);
+        return status;
+    }
+
+    DBG_PRINT("Creating OpenCL context...\n");
+    narrowphase->context = clCreateContext(NULL, 1, &narrowphase->device, NULL, NULL, &status);
+    if (status != CL_SUCCESS) {
+        printf("Error creating context: %d\n", status);
+        return status;
+    }
+
+    DBG_PRINT("Creating OpenCL command queue...\n");
+    narrowphase->queue = clCreateCommandQueue(narrowphase->context, narrowphase->device, CL_QUEUE_PROFILING_ENABLE, &status);
+    if (status != CL_SUCCESS) {
+        printf("Error creating command queue: %d\n", status);
+        return status;
+    }
+
+    const char* sources[] = { find_collisions_kernel_str, broadphase_kernel_str };
+    char options[64];
+    char key[CL_CACHE_KEY_SIZE];
+    snprintf(options, sizeof(options), "-DMAX_VERTICES=%d -DPAIR_GROUP_SIZE=%d", MAX_VERTICES, CL_PAIR_GROUP_SIZE);
+    program_cache_key(narrowphase, sources, ARRAY_SIZE(sources), options, key);
+
+    DBG_PRINT("Loading cached OpenCL program...\n");
+    narrowphase->program = load_cached_program(narrowphase, key, options);
+    if (narrowphase->program == NULL) {
+        DBG_PRINT("Creating OpenCL program with kernel source...\n");
+        narrowphase->program = clCreateProgramWithSource(narrowphase->context, ARRAY_SIZE(sources), sources, NULL, &status);
+        if (status != CL_SUCCESS) {
+            printf("Error creating program: %d\n", status);
+            return status;
+        }
+        status = clBuildProgram(narrowphase->program, 1, &narrowphase->device, options, NULL, NULL);
+        if (status != CL_SUCCESS) {
+            char log[4096];
+            clGetProgramBuildInfo(narrowphase->program, narrowphase->device, CL_PROGRAM_BUILD_LOG, sizeof(log), log, NULL);
+            printf("Error building program: %d\n%s\n", status, log);
+            return status;
+        }
+        save_program_binary(narrowphase, key);
+    }
+
+    DBG_PRINT("Creating OpenCL kernels...\n");
+    narrowphase->kernel = clCreateKernel(narrowphase->program, "find_collisions", &status);
+    if (status == CL_SUCCESS)
+        narrowphase->aabbs_kernel = clCreateKernel(narrowphase->program, "compute_aabbs", &status);
+    if (status == CL_SUCCESS)
+        narrowphase->sort_kernel = clCreateKernel(narrowphase->program, "bitonic_sort_step", &status);
+    if (status == CL_SUCCESS)
+        narrowphase->sweep_kernel = clCreateKernel(narrowphase->program, "sweep_pairs", &status);
+    if (status != CL_SUCCESS) {
+        printf("Error creating kernel: %d\n", status);
+        return status;
+    }
+
+    narrowphase->counts_buffer = clCreateBuffer(narrowphase->context, CL_MEM_READ_WRITE, 2 * sizeof(int), NULL, &status);
+    if (status != CL_SUCCESS) {
+        printf("Error creating counts buffer: %d\n", status);
+        return status;
+    }
+    clSetKernelArg(narrowphase->kernel, 4, sizeof(cl_mem), &narrowphase->counts_buffer);
+    clSetKernelArg(narrowphase->sweep_kernel, 6, sizeof(cl_mem), &narrowphase->counts_buffer);
+
+    return CL_SUCCESS;
+}
+
+// packs the vertices of every shape into one read only buffer and records where each shape starts.
+// shapes never change, so this happens once
+int cl_upload_shapes(CL_NARROWPHASE* narrowphase, POLYGON* shapes[], int num_shapes) {
+    int status;
+    int num_vertices = 0;
+
+    for (int i = 0; i < num_shapes; i++) {
+        shapes[i]->device_offset = num_vertices;
+        num_vertices += shapes[i]->vertices_idx;
+    }
+
+    VECTOR* packed = (VECTOR*)malloc(num_vertices * sizeof(VECTOR));
+    for (int i = 0; i < num_shapes; i++)
+        memcpy(&packed[shapes[i]->device_offset], shapes[i]->vertices, shapes[i]->vertices_idx * sizeof(VECTOR));
+
+    narrowphase->shapes_buffer = clCreateBuffer(narrowphase->context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, num_vertices * sizeof(VECTOR), packed, &status);
+    free(packed);
+    if (status != CL_SUCCESS) {
+        printf("Error creating shapes buffer: %d\n", status);
+        return status;
+    }
+
+    clSetKernelArg(narrowphase->kernel, 0, sizeof(cl_mem), &narrowphase->shapes_buffer);
+    return CL_SUCCESS;
+}
+
+// device buffers are shared by both frames, the in order queue finishes one frame's kernel before the next
+// frame's writes land. they only grow, so frames after the busiest one so far reuse them
+static int reserve_bodies(CL_NARROWPHASE* narrowphase, int num_bodies) {
+    int status;
+    int capacity = (narrowphase->bodies_capacity > 0) ? narrowphase->bodies_capacity : BODY_STORE_INITIAL_CAPACITY;
+
+    if (num_bodies <= narrowphase->bodies_capacity)
+        return CL_SUCCESS;
+    while (capacity < num_bodies)
+        capacity *= 2;
+
+    if (narrowphase->body_shapes_buffer)
+        clReleaseMemObject(narrowphase->body_shapes_buffer);
+    if (narrowphase->positions_buffer)
+        clReleaseMemObject(narrowphase->positions_buffer);
+    if (narrowphase->aabbs_buffer)
+        clReleaseMemObject(narrowphase->aabbs_buffer);
+    if (narrowphase->keys_buffer)
+        clReleaseMemObject(narrowphase->keys_buffer);
+    narrowphase->body_shapes_buffer = NULL;
+    narrowphase->positions_buffer = NULL;
+    narrowphase->aabbs_buffer = NULL;
+    narrowphase->keys_buffer = NULL;
+    narrowphase->bodies_capacity = 0;
+    narrowphase->uploaded_layout = -1;
+
+    narrowphase->body_shapes_buffer = clCreateBuffer(narrowphase->context, CL_MEM_READ_ONLY, capacity * sizeof(CL_BODY_SHAPE), NULL, &status);
+    if (status != CL_SUCCESS) {
+        printf("Error creating body shapes buffer: %d\n", status);
+        return status;
+    }
+    narrowphase->positions_buffer = clCreateBuffer(narrowphase->context, CL_MEM_READ_ONLY, capacity * sizeof(VECTOR), NULL, &status);
+    if (status != CL_SUCCESS) {
+        printf("Error creating positions buffer: %d\n", status);
+        return status;
+    }
+
+    narrowphase->aabbs_buffer = clCreateBuffer(narrowphase->context, CL_MEM_READ_WRITE, capacity * sizeof(AABB), NULL, &status);
+    if (status != CL_SUCCESS) {
+        printf("Error creating aabbs buffer: %d\n", status);
+        return status;
+    }
+    // the capacity doubles from a power of two, so the sort never needs more keys than this
+    narrowphase->keys_buffer = clCreateBuffer(narrowphase->context, CL_MEM_READ_WRITE, capacity * 2 * sizeof(int), NULL, &status);
+    if (status != CL_SUCCESS) {
+        printf("Error creating keys buffer: %d\n", status);
+        return status;
+    }
+
+    clSetKernelArg(narrowphase->kernel, 1, sizeof(cl_mem), &narrowphase->body_shapes_buffer);
+    clSetKernelArg(narrowphase->kernel, 2, sizeof(cl_mem), &narrowphase->positions_buffer);
+    clSetKernelArg(narrowphase->aabbs_kernel, 0, sizeof(cl_mem), &narrowphase->body_shapes_buffer);
+    clSetKernelArg(narrowphase->aabbs_kernel, 1, sizeof(cl_mem), &narrowphase->positions_buffer);
+    clSetKernelArg(narrowphase->aabbs_kernel, 3, sizeof(cl_mem), &narrowphase->aabbs_buffer);
+    clSetKernelArg(narrowphase->aabbs_kernel, 4, sizeof(cl_mem), &narrowphase->keys_buffer);
+    clSetKernelArg(narrowphase->sort_kernel, 0, sizeof(cl_mem), &narrowphase->keys_buffer);
+    clSetKernelArg(narrowphase->sweep_kernel, 0, sizeof(cl_mem), &narrowphase->keys_buffer);
+    clSetKernelArg(narrowphase->sweep_kernel, 1, sizeof(cl_mem), &narrowphase->aabbs_buffer);
+    narrowphase->bodies_capacity = capacity;
+    return CL_SUCCESS;
+}
+
+static int reserve_pairs(CL_NARROWPHASE* narrowphase, int num_pairs) {
+    int status;
+    int capacity = (narrowphase->pairs_capacity > 0) ? narrowphase->pairs_capacity : CL_INITIAL_PAIR_CAPACITY;
+
+    if (narrowphase->pairs_buffer && num_pairs <= narrowphase->pairs_capacity)
+        return CL_SUCCESS;
+    while (capacity < num_pairs)
+        capacity *= 2;
+
+    if (narrowphase->pairs_buffer)
+        clReleaseMemObject(narrowphase->pairs_buffer);
+    if (narrowphase->colliding_buffer)
+        clReleaseMemObject(narrowphase->colliding_buffer);
+    narrowphase->pairs_buffer = NULL;
+    narrowphase->colliding_buffer = NULL;
+    narrowphase->pairs_capacity = 0;
+
+    narrowphase->pairs_buffer = clCreateBuffer(narrowphase->context, CL_MEM_READ_WRITE, capacity * sizeof(CL_PAIR), NULL, &status);
+    if (status != CL_SUCCESS) {
+        printf("Error creating pairs buffer: %d\n", status);
+        return status;
+    }
+    narrowphase->colliding_buffer = clCreateBuffer(narrowphase->context, CL_MEM_WRITE_ONLY, capacity * sizeof(int), NULL, &status);
+    if (status != CL_SUCCESS) {
+        printf("Error creating colliding buffer: %d\n", status);
+        return status;
+    }
+
+    clSetKernelArg(narrowphase->kernel, 3, sizeof(cl_mem), &narrowphase->pairs_buffer);
+    clSetKernelArg(narrowphase->kernel, 5, sizeof(int), &capacity);
+    clSetKernelArg(narrowphase->kernel, 6, sizeof(cl_mem), &narrowphase->colliding_buffer);
+    clSetKernelArg(narrowphase->sweep_kernel, 5, sizeof(cl_mem), &narrowphase->pairs_buffer);
+    clSetKernelArg(narrowphase->sweep_kernel, 7, sizeof(int), &capacity);
+    narrowphase->pairs_capacity = capacity;
+    return CL_SUCCESS;
+}
+
+static int reserve_hits(CL_NARROWPHASE* narrowphase, int num_hits) {
+    int status;
+    int capacity = (narrowphase->hits_capacity > 0) ? narrowphase->hits_capacity : CL_INITIAL_HIT_CAPACITY;
+
+    if (narrowphase->hits_buffer && num_hits <= narrowphase->hits_capacity)
+        return CL_SUCCESS;
+    while (capacity < num_hits)
+        capacity *= 2;
+
+    if (narrowphase->hits_buffer)
+        clReleaseMemObject(narrowphase->hits_buffer);
+    narrowphase->hits_buffer = NULL;
+    narrowphase->hits_capacity = 0;
+
+    narrowphase->hits_buffer = clCreateBuffer(narrowphase->context, CL_MEM_WRITE_ONLY, capacity * sizeof(CL_PAIR), NULL, &status);
+    if (status != CL_SUCCESS) {
+        printf("Error creating hits buffer: %d\n", status);
+        return status;
+    }
+
+    clSetKernelArg(narrowphase->kernel, 7, sizeof(cl_mem), &narrowphase->hits_buffer);
+    clSetKernelArg(narrowphase->kernel, 8, sizeof(int), &capacity);
+    narrowphase->hits_capacity = capacity;
+    return CL_SUCCESS;
+}
+
+// host side staging of a frame only grows, and only once the frame's results have been collected
+static void reserve_frame(CL_FRAME* frame, int num_bodies, int num_pairs) {
+    if (num_bodies > frame->bodies_capacity) {
+        frame->bodies_capacity = (frame->bodies_capacity > 0) ? frame->bodies_capacity : BODY_STORE_INITIAL_CAPACITY;
+        while (frame->bodies_capacity < num_bodies)
+            frame->bodies_capacity *= 2;
+        frame->positions = (VECTOR*)realloc(frame->positions, frame->bodies_capacity * sizeof(VECTOR));
+        frame->body_shapes = (CL_BODY_SHAPE*)realloc(frame->body_shapes, frame->bodies_capacity * sizeof(CL_BODY_SHAPE));
+        frame->handles = (BODY_HANDLE*)realloc(frame->handles, frame->bodies_capacity * sizeof(BODY_HANDLE));
+    }
+    if (num_pairs > frame->pairs_capacity) {
+        frame->pairs_capacity = (frame->pairs_capacity > 0) ? frame->pairs_capacity : CL_INITIAL_PAIR_CAPACITY;
+        while (frame->pairs_capacity < num_pairs)
+            frame->pairs_capacity *= 2;
+        frame->pairs = (COLLISION_PAIR*)realloc(frame->pairs, frame->pairs_capacity * sizeof(COLLISION_PAIR));
+        frame->cl_pairs = (CL_PAIR*)realloc(frame->cl_pairs, frame->pairs_capacity * sizeof(CL_PAIR));
+        frame->colliding = (int*)realloc(frame->colliding, frame->pairs_capacity * sizeof(int));
+    }
+}
+
+static void release_kernel_event(CL_FRAME* frame) {
+    if (frame->kernel_started)
+        clReleaseEvent(frame->kernel_started);
+    frame->kernel_started = NULL;
+}
+
+// also takes how long the device spent on the frame, from the start of its kernel to the end of the read back
+static int wait_frame(CL_FRAME* frame) {
+    int status = CL_SUCCESS;
+    cl_ulong start = 0, end = 0;
+
+    frame->device_time = 0.0;
+    if (frame->done) {
+        status = clWaitForEvents(1, &frame->done);
+        if (status == CL_SUCCESS && frame->kernel_started
+            && clGetEventProfilingInfo(frame->kernel_started, CL_PROFILING_COMMAND_START, sizeof(start), &start, NULL) == CL_SUCCESS
+            && clGetEventProfilingInfo(frame->done, CL_PROFILING_COMMAND_END, sizeof(end), &end, NULL) == CL_SUCCESS
+            && end > start)
+            frame->device_time = (end - start) / 1000.0;
+        clReleaseEvent(frame->done);
+        frame->done = NULL;
+    }
+    release_kernel_event(frame);
+    return status;
+}
+
+// the body shapes only go up when the layout changed since the last upload, the positions go up every frame
+static int upload_bodies(CL_NARROWPHASE* narrowphase, CL_FRAME* frame, BODY_STORE* store) {
+    int status;
+
+    if (narrowphase->uploaded_layout != store->layout_version) {
+        for (int i = 0; i < store->count; i++) {
+            frame->body_shapes[i].vertices_offset = store->shapes[i]->device_offset;
+            frame->body_shapes[i].vertices_count = store->shapes[i]->vertices_idx;
+            frame->body_shapes[i].aabb = store->shapes[i]->aabb;
+        }
+        status = clEnqueueWriteBuffer(narrowphase->queue, narrowphase->body_shapes_buffer, CL_FALSE, 0, store->count * sizeof(CL_BODY_SHAPE), frame->body_shapes, 0, NULL, NULL);
+        if (status != CL_SUCCESS) {
+            DBG_PRINT("Error writing body shapes buffer: %d\n", status);
+            return status;
+        }
+        narrowphase->uploaded_layout = store->layout_version;
+    }
+
+    memcpy(frame->positions, store->positions, store->count * sizeof(VECTOR));
+    status = clEnqueueWriteBuffer(narrowphase->queue, narrowphase->positions_buffer, CL_FALSE, 0, store->count * sizeof(VECTOR), frame->positions, 0, NULL, NULL);
+    if (status != CL_SUCCESS)
+        DBG_PRINT("Error writing positions buffer: %d\n", status);
+    return status;
+}
+
+// room for the latest count we have plus a quarter, rounded up to CL_PAIR_LAUNCH_STEP and at most capacity.
+// the counts of a frame stay on the device until it is collected, so this is the best guess at submit
+static int headroom(int last_count, int capacity) {
+    int count;
+    if (last_count < 0)
+        return capacity;
+
+    count = last_count + last_count / 4;
+    count = (count / CL_PAIR_LAUNCH_STEP + 1) * CL_PAIR_LAUNCH_STEP;
+    return (count < capacity) ? count : capacity;
+}
+
+static int enqueue_find_collisions(CL_NARROWPHASE* narrowphase, CL_FRAME* frame, int num_groups) {
+    size_t global_size[1] = {num_groups * CL_PAIR_GROUP_SIZE};
+    size_t local_size[1] = {CL_PAIR_GROUP_SIZE};
+    int status = clEnqueueNDRangeKernel(narrowphase->queue, narrowphase->kernel, 1, NULL, global_size, local_size, 0, NULL, &frame->kernel_started);
+    if (status != CL_SUCCESS)
+        DBG_PRINT("Error enqueueing kernel: %d\n", status);
+    return status;
+}
+
+// queues this frame's pairs and returns without waiting. the store and the pairs are copied into the frame's
+// staging first, so the caller can move bodies and reset its frame arena straight away. every enqueued command
+// reads from that staging, which is left alone until cl_collect_collisions has waited for the frame
+int cl_submit_collisions(CL_NARROWPHASE* narrowphase, BODY_STORE* store, COLLISION_PAIR pairs[], int num_pairs) {
+    int status;
+    CL_FRAME* frame = &narrowphase->frames[narrowphase->current_frame];
+
+    wait_frame(frame);
+    frame->num_pairs = 0;
+    frame->device_broadphase = 0;
+    narrowphase->current_frame = (narrowphase->current_frame + 1) % CL_FRAMES_IN_FLIGHT;
+    if (num_pairs == 0)
+        return CL_SUCCESS;
+
+    reserve_frame(frame, store->count, num_pairs);
+    status = reserve_bodies(narrowphase, store->count);
+    if (status == CL_SUCCESS)
+        status = reserve_pairs(narrowphase, num_pairs);
+    if (status == CL_SUCCESS)
+        status = reserve_hits(narrowphase, 0);
+    if (status == CL_SUCCESS)
+        status = upload_bodies(narrowphase, frame, store);
+    if (status != CL_SUCCESS)
+        goto Error;
+
+    memcpy(frame->pairs, pairs, num_pairs * sizeof(COLLISION_PAIR));
+    for (int i = 0; i < num_pairs; i++) {
+        frame->cl_pairs[i].body1 = body_index(store, pairs[i].body1);
+        frame->cl_pairs[i].body2 = body_index(store, pairs[i].body2);
+        frame->cl_pairs[i].offset_x = pairs[i].offset.x;
+        frame->cl_pairs[i].offset_y = pairs[i].offset.y;
+    }
+    status = clEnqueueWriteBuffer(narrowphase->queue, narrowphase->pairs_buffer, CL_FALSE, 0, num_pairs * sizeof(CL_PAIR), frame->cl_pairs, 0, NULL, NULL);
+    if (status != CL_SUCCESS) {
+        DBG_PRINT("Error writing pairs buffer: %d\n", status);
+        goto Error;
+    }
+
+    frame->counts[0] = num_pairs;
+    frame->counts[1] = 0;
+    status = clEnqueueWriteBuffer(narrowphase->queue, narrowphase->counts_buffer, CL_FALSE, 0, sizeof(frame->counts), frame->counts, 0, NULL, NULL);
+    if (status != CL_SUCCESS) {
+        DBG_PRINT("Error writing counts buffer: %d\n", status);
+        goto Error;
+    }
+
+    status = enqueue_find_collisions(narrowphase, frame, num_pairs);
+    if (status != CL_SUCCESS)
+        goto Error;
+
+    status = clEnqueueReadBuffer(narrowphase->queue, narrowphase->colliding_buffer, CL_FALSE, 0, num_pairs * sizeof(int), frame->colliding, 0, NULL, &frame->done);
+    if (status != CL_SUCCESS) {
+        printf("Error reading colliding buffer: %d\n", status);
+        goto Error;
+    }
+
+    // start the device now instead of at the next blocking call
+    clFlush(narrowphase->queue);
+    frame->num_pairs = num_pairs;
+    return CL_SUCCESS;
+
+Error:
+    // nothing may still be reading the staging once this frame is handed back empty
+    clFinish(narrowphase->queue);
+    release_kernel_event(frame);
+    narrowphase->uploaded_layout = -1;
+    return status;
+}
+
+// like cl_submit_collisions but the device finds the pairs itself from the mirrored bodies, so only positions go
+// up and only the colliding pairs come back. pair and hit counts are not known before the kernels ran, a frame
+// that finds more than there is room for drops the rest and the buffers grow for the frames after it
+int cl_submit_device_collisions(CL_NARROWPHASE* narrowphase, BODY_STORE* store, int world_width, int world_height) {
+    int status;
+    size_t global_size[1];
+    int num_keys = 1;
+    CL_FRAME* frame = &narrowphase->frames[narrowphase->current_frame];
+
+    wait_frame(frame);
+    frame->num_pairs = 0;
+    frame->device_broadphase = 1;
+    narrowphase->current_frame = (narrowphase->current_frame + 1) % CL_FRAMES_IN_FLIGHT;
+    if (store->count < 2)
+        return CL_SUCCESS;
+
+    status = reserve_bodies(narrowphase, store->count);
+    if (status == CL_SUCCESS)
+        status = reserve_pairs(narrowphase, narrowphase->device_pairs_needed);
+    if (status == CL_SUCCESS)
+        status = reserve_hits(narrowphase, narrowphase->device_hits_needed);
+    if (status != CL_SUCCESS)
+        goto Error;
+    reserve_frame(frame, store->count, narrowphase->hits_capacity);
+
+    status = upload_bodies(narrowphase, frame, store);
+    if (status != CL_SUCCESS)
+        goto Error;
+    for (int i = 0; i < store->count; i++)
+        frame->handles[i] = body_handle(store, i);
+
+    frame->counts[0] = 0;
+    frame->counts[1] = 0;
+    status = clEnqueueWriteBuffer(narrowphase->queue, narrowphase->counts_buffer, CL_FALSE, 0, sizeof(frame->counts), frame->counts, 0, NULL, NULL);
+    if (status != CL_SUCCESS) {
+        DBG_PRINT("Error writing counts buffer: %d\n", status);
+        goto Error;
+    }
+
+    while (num_keys < store->count)
+        num_keys *= 2;
+    global_size[0] = num_keys;
+    clSetKernelArg(narrowphase->aabbs_kernel, 2, sizeof(int), &store->count);
+    status = clEnqueueNDRangeKernel(narrowphase->queue, narrowphase->aabbs_kernel, 1, NULL, global_size, NULL, 0, NULL, NULL);
+    for (int k = 2; k <= num_keys && status == CL_SUCCESS; k *= 2) {
+        for (int j = k / 2; j > 0 && status == CL_SUCCESS; j /= 2) {
+            clSetKernelArg(narrowphase->sort_kernel, 1, sizeof(int), &j);
+            clSetKernelArg(narrowphase->sort_kernel, 2, sizeof(int), &k);
+            status = clEnqueueNDRangeKernel(narrowphase->queue, narrowphase->sort_kernel, 1, NULL, global_size, NULL, 0, NULL, NULL);
+        }
+    }
+    if (status == CL_SUCCESS) {
+        global_size[0] = store->count;
+        clSetKernelArg(narrowphase->sweep_kernel, 2, sizeof(int), &store->count);
+        clSetKernelArg(narrowphase->sweep_kernel, 3, sizeof(int), &world_width);
+        clSetKernelArg(narrowphase->sweep_kernel, 4, sizeof(int), &world_height);
+        status = clEnqueueNDRangeKernel(narrowphase->queue, narrowphase->sweep_kernel, 1, NULL, global_size, NULL, 0, NULL, NULL);
+    }
+    if (status != CL_SUCCESS) {
+        DBG_PRINT("Error enqueueing broad phase kernels: %d\n", status);
+        goto Error;
+    }
+
+    // groups past the pair count return straight away, pairs past the launch are caught up next frame
+    frame->launched_pairs = headroom(narrowphase->device_pairs_last, narrowphase->pairs_capacity);
+    status = enqueue_find_collisions(narrowphase, frame, frame->launched_pairs);
+    if (status != CL_SUCCESS)
+        goto Error;
+
+    // the next submit reuses the hits buffer, so the read is queued now, sized like the launch.
+    // there are never more hits than launched pairs
+    frame->num_pairs = headroom(narrowphase->device_hits_last, narrowphase->hits_capacity);
+    if (frame->num_pairs > frame->launched_pairs)
+        frame->num_pairs = frame->launched_pairs;
+    status = clEnqueueReadBuffer(narrowphase->queue, narrowphase->counts_buffer, CL_FALSE, 0, sizeof(frame->counts), frame->counts, 0, NULL, NULL);
+    if (status == CL_SUCCESS)
+        status = clEnqueueReadBuffer(narrowphase->queue, narrowphase->hits_buffer, CL_FALSE, 0, frame->num_pairs * sizeof(CL_PAIR), frame->cl_pairs, 0, NULL, &frame->done);
+    if (status != CL_SUCCESS) {
+        printf("Error reading hits buffer: %d\n", status);
+        goto Error;
+    }
+
+    clFlush(narrowphase->queue);
+    return CL_SUCCESS;
+
+Error:
+    clFinish(narrowphase->queue);
+    release_kernel_event(frame);
+    frame->num_pairs = 0;
+    narrowphase->uploaded_layout = -1;
+    return status;
+}
+
+// waits for the frame submitted before the latest one and hands back its pairs with a colliding flag each.
+// the pairs are a frame old, so their handles may be stale by now. they stay valid until the next submit
+int cl_collect_collisions(CL_NARROWPHASE* narrowphase, COLLISION_PAIR* p_pairs[], int* p_colliding[], int* p_num_pairs) {
+    CL_FRAME* frame = &narrowphase->frames[narrowphase->current_frame];
+    int status = wait_frame(frame);
+
+    if (status != CL_SUCCESS) {
+        printf("Error waiting for collisions: %d\n", status);
+        frame->num_pairs = 0;
+    }
+    narrowphase->device_time = frame->device_time;
+
+    if (frame->device_broadphase && frame->num_pairs > 0) {
+        narrowphase->device_pairs_last = frame->counts[0];
+        narrowphase->device_hits_last = frame->counts[1];
+        if (frame->counts[0] > narrowphase->device_pairs_needed)
+            narrowphase->device_pairs_needed = frame->counts[0];
+        if (frame->counts[1] > narrowphase->device_hits_needed)
+            narrowphase->device_hits_needed = frame->counts[1];
+        // anything dropped here is missed for this frame only, the next one is sized to cover it
+        if (frame->counts[0] > narrowphase->pairs_capacity)
+            DBG_PRINT("Device broad phase found %d pairs, room for %d\n", frame->counts[0], narrowphase->pairs_capacity);
+        if (frame->counts[0] > frame->launched_pairs)
+            DBG_PRINT("Device collision launch covered %d of %d pairs\n", frame->launched_pairs, frame->counts[0]);
+        if (frame->counts[1] > frame->num_pairs)
+            DBG_PRINT("Read back %d of %d device hits\n", frame->num_pairs, frame->counts[1]);
+
+        // only colliding pairs came back
+        if (frame->counts[1] < frame->num_pairs)
+            frame->num_pairs = frame->counts[1];
+        for (int i = 0; i < frame->num_pairs; i++) {
+            CL_PAIR* hit = &frame->cl_pairs[i];
+            frame->pairs[i].body1 = frame->handles[hit->body1];
+            frame->pairs[i].body2 = frame->handles[hit->body2];
+            frame->pairs[i].offset.x = hit->offset_x;
+            frame->pairs[i].offset.y = hit->offset_y;
+            frame->colliding[i] = 1;
+        }
+    }
+
+    *p_pairs = frame->pairs;
+    *p_colliding = frame->colliding;
+    *p_num_pairs = frame->num_pairs;
+    return status;
+}
+
+void release_cl_narrowphase(CL_NARROWPHASE* narrowphase) {
+    if (narrowphase->queue)
+        clFinish(narrowphase->queue);
+    for (int i = 0; i < CL_FRAMES_IN_FLIGHT; i++) {
+        CL_FRAME* frame = &narrowphase->frames[i];
+        if (frame->done)
+            clReleaseEvent(frame->done);
+        release_kernel_event(frame);
+        free(frame->pairs);
+        free(frame->cl_pairs);
+        free(frame->colliding);
+        free(frame->positions);
+        free(frame->body_shapes);
+        free(frame->handles);
+    }
+    if (narrowphase->pairs_buffer)
+        clReleaseMemObject(narrowphase->pairs_buffer);
+    if (narrowphase->colliding_buffer)
+        clReleaseMemObject(narrowphase->colliding_buffer);
+    if (narrowphase->counts_buffer)
+        clReleaseMemObject(narrowphase->counts_buffer);
+    if (narrowphase->hits_buffer)
+        clReleaseMemObject(narrowphase->hits_buffer);
+    if (narrowphase->aabbs_buffer)
+        clReleaseMemObject(narrowphase->aabbs_buffer);
+    if (narrowphase->keys_buffer)
+        clReleaseMemObject(narrowphase->keys_buffer);
+    if (narrowphase->shapes_buffer)
+        clReleaseMemObject(narrowphase->shapes_buffer);
+    if (narrowphase->body_shapes_buffer)
+        clReleaseMemObject(narrowphase->body_shapes_buffer);
+    if (narrowphase->positions_buffer)
+        clReleaseMemObject(narrowphase->positions_buffer);
+    if (narrowphase->kernel)
+        clReleaseKernel(narrowphase->kernel);
+    if (narrowphase->aabbs_kernel)
+        clReleaseKernel(narrowphase->aabbs_kernel);
+    if (narrowphase->sort_kernel)
+        clReleaseKernel(narrowphase->sort_kernel);
+    if (narrowphase->sweep_kernel)
+        clReleaseKernel(narrowphase->sweep_kernel);
+    if (narrowphase->program)
+        clReleaseProgram(narrowphase->program);
+    if (narrowphase->queue)
+        clReleaseCommandQueue(narrowphase->queue);
+    if (narrowphase->context)
+        clReleaseContext(narrowphase->context);
+    memset(narrowphase, 0, sizeof(CL_NARROWPHASE));
+}
+#endif
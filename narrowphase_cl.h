@@ -0,0 +1,97 @@
+#ifndef NARROWPHASE_CL_H
+#define NARROWPHASE_CL_H
+
+#ifdef ENABLE_OPENCL
+#include "CL/cl.h"
+#include "broadphase.h"
+
+#define CL_MAX_PLATFORMS 8
+#define CL_INITIAL_PAIR_CAPACITY 256
+#define CL_INITIAL_HIT_CAPACITY 64
+#define CL_FRAMES_IN_FLIGHT 2 // the frame being worked on by the device and the one being resolved
+#define CL_CACHE_FILE "collisions_cl.bin" // built program binary, reused while device, driver and source match
+#define CL_CACHE_KEY_SIZE 512
+#define CL_CACHE_MAX_BINARY_SIZE (64 * 1024 * 1024)
+#define CL_PAIR_GROUP_SIZE 64 // work-items per pair, a power of two. 2 * MAX_VERTICES or more gives each edge its own
+#define CL_PAIR_LAUNCH_STEP 64 // device broad phase launches and hit reads are rounded up to this many pairs
+
+// one candidate pair as the kernel sees it. bodies are dense indices into the uploaded body store,
+// offset is the seam offset of the broad phase pair
+typedef struct {
+    int body1;
+    int body2;
+    int offset_x;
+    int offset_y;
+} CL_PAIR;
+
+// the shape of a body as a range of the packed shape buffer, with its local aabb for the device broad phase
+typedef struct {
+    int vertices_offset;
+    int vertices_count;
+    AABB aabb;
+} CL_BODY_SHAPE;
+
+// host side of one submitted frame. everything the device reads from or writes to is staged here
+typedef struct {
+    COLLISION_PAIR* pairs; // as submitted, to resolve once the results are back
+    CL_PAIR* cl_pairs; // the colliding pairs read back when the device found the pairs itself
+    int* colliding;
+    VECTOR* positions;
+    CL_BODY_SHAPE* body_shapes;
+    BODY_HANDLE* handles; // dense index to handle at submit, to name the bodies of device found pairs
+    int counts[2]; // device pair and hit counts
+    int launched_pairs; // pairs the find_collisions launch covered with the device broad phase
+    int device_broadphase;
+    int num_pairs; // pairs submitted, or hits read back with the device broad phase
+    int pairs_capacity;
+    int bodies_capacity;
+    cl_event kernel_started; // profiled together with done
+    cl_event done; // the read of the results, NULL once collected
+    double device_time;
+} CL_FRAME;
+
+// shapes stay on the device for good and bodies are mirrored there as shape ranges and positions.
+// a frame uploads its positions and pairs, runs one kernel launch and reads the results back without
+// blocking. they are collected a frame later, so the device works while the cpu resolves and renders.
+// with the device broad phase the pairs never leave the device either, only the colliding ones come back
+typedef struct {
+    cl_platform_id platform;
+    cl_device_id device;
+    cl_context context;
+    cl_command_queue queue;
+    cl_program program;
+    cl_kernel kernel;
+    cl_kernel aabbs_kernel;
+    cl_kernel sort_kernel;
+    cl_kernel sweep_kernel;
+    cl_mem shapes_buffer; // vertices of every shape back to back, uploaded once
+    cl_mem body_shapes_buffer; // only rewritten when the body store layout changes
+    cl_mem positions_buffer; // rewritten every frame
+    int bodies_capacity;
+    int uploaded_layout; // layout_version of the body store in body_shapes_buffer, -1 for none
+    cl_mem aabbs_buffer;
+    cl_mem keys_buffer; // min x and dense index of every body, sorted on the device
+    cl_mem pairs_buffer;
+    cl_mem colliding_buffer; // one int per pair
+    int pairs_capacity;
+    cl_mem counts_buffer; // pairs found by the device broad phase and colliding pairs
+    cl_mem hits_buffer;
+    int hits_capacity;
+    int device_pairs_needed; // largest device pair and hit counts seen, the buffers grow to them
+    int device_hits_needed;
+    int device_pairs_last; // device pair and hit counts of the latest collected frame, they size the next launch
+    int device_hits_last; // and hit read. -1 for none yet
+    CL_FRAME frames[CL_FRAMES_IN_FLIGHT];
+    double device_time; // microseconds the last collected frame took on the device
+    int current_frame; // next to submit, and after a submit the one to collect
+} CL_NARROWPHASE;
+
+int create_cl_narrowphase(CL_NARROWPHASE* narrowphase, cl_device_type device_type);
+int cl_upload_shapes(CL_NARROWPHASE* narrowphase, POLYGON* shapes[], int num_shapes);
+int cl_submit_collisions(CL_NARROWPHASE* narrowphase, BODY_STORE* store, COLLISION_PAIR pairs[], int num_pairs);
+int cl_submit_device_collisions(CL_NARROWPHASE* narrowphase, BODY_STORE* store, int world_width, int world_height);
+int cl_collect_collisions(CL_NARROWPHASE* narrowphase, COLLISION_PAIR* p_pairs[], int* p_colliding[], int* p_num_pairs);
+void release_cl_narrowphase(CL_NARROWPHASE* narrowphase);
+#endif
+
+#endif  // NARROWPHASE_CL_H
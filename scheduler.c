@@ -0,0 +1,45 @@
+#include "scheduler.h"
+
+void create_pair_scheduler(PAIR_SCHEDULER* scheduler) {
+    scheduler->cpu_pair_cost = 0.0;
+    scheduler->device_pair_cost = 0.0;
+    scheduler->device_share = 0.5;
+}
+
+int scheduler_device_pairs(PAIR_SCHEDULER* scheduler, int num_pairs) {
+    return (int)(num_pairs * scheduler->device_share + 0.5);
+}
+
+static void update_share(PAIR_SCHEDULER* scheduler) {
+    if (scheduler->cpu_pair_cost <= 0.0 || scheduler->device_pair_cost <= 0.0)
+        return;
+
+    // n * share * device cost = n * (1 - share) * cpu cost
+    scheduler->device_share = scheduler->cpu_pair_cost / (scheduler->cpu_pair_cost + scheduler->device_pair_cost);
+    if (scheduler->device_share < SCHEDULER_MIN_SHARE)
+        scheduler->device_share = SCHEDULER_MIN_SHARE;
+    if (scheduler->device_share > 1.0 - SCHEDULER_MIN_SHARE)
+        scheduler->device_share = 1.0 - SCHEDULER_MIN_SHARE;
+}
+
+static void record(double* p_cost, int num_pairs, double time) {
+    double cost;
+    if (num_pairs == 0)
+        return;
+
+    cost = time / num_pairs;
+    if (*p_cost <= 0.0)
+        *p_cost = cost;
+    else
+        *p_cost += SCHEDULER_SMOOTHING * (cost - *p_cost);
+}
+
+void scheduler_record_cpu(PAIR_SCHEDULER* scheduler, int num_pairs, double time) {
+    record(&scheduler->cpu_pair_cost, num_pairs, time);
+    update_share(scheduler);
+}
+
+void scheduler_record_device(PAIR_SCHEDULER* scheduler, int num_pairs, double time) {
+    record(&scheduler->device_pair_cost, num_pairs, time);
+    update_share(scheduler);
+}
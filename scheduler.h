@@ -0,0 +1,21 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#define SCHEDULER_SMOOTHING 0.1 // weight of the newest frame in the cost averages
+#define SCHEDULER_MIN_SHARE 0.05 // both sides keep some pairs so their cost stays measured
+
+// splits the candidate pairs of a frame between the opencl batch and the cpu narrow phase. the
+// device runs its share while the cpu works through the rest, so the share is picked to make both
+// take about as long, from moving averages of what a pair has cost on either side
+typedef struct {
+    double cpu_pair_cost; // microseconds per pair, 0 until measured
+    double device_pair_cost; // the kernel plus the cpu epa run on what it found
+    double device_share; // fraction of the pairs handed to the device
+} PAIR_SCHEDULER;
+
+void create_pair_scheduler(PAIR_SCHEDULER* scheduler);
+int scheduler_device_pairs(PAIR_SCHEDULER* scheduler, int num_pairs);
+void scheduler_record_cpu(PAIR_SCHEDULER* scheduler, int num_pairs, double time);
+void scheduler_record_device(PAIR_SCHEDULER* scheduler, int num_pairs, double time);
+
+#endif  // SCHEDULER_H
@@ -0,0 +1,151 @@
+#include <string.h>
+#include "threadpool.h"
+#include "utils.h"
+
+static int pop_bottom(WORK_DEQUE* deque, TASK_RANGE* range) {
+    int found = 0;
+    SDL_AtomicLock(&deque->lock);
+    if (deque->bottom > deque->top) {
+        *range = deque->ranges[--deque->bottom];
+        found = 1;
+    }
+    SDL_AtomicUnlock(&deque->lock);
+    return found;
+}
+
+static int steal_top(WORK_DEQUE* deque, TASK_RANGE* range) {
+    int found = 0;
+    SDL_AtomicLock(&deque->lock);
+    if (deque->bottom > deque->top) {
+        *range = deque->ranges[deque->top++];
+        found = 1;
+    }
+    SDL_AtomicUnlock(&deque->lock);
+    return found;
+}
+
+// own chunks first, then the other deques in turn. nothing is added during a run, so once a
+// full sweep finds every deque empty the worker is done
+static void run_tasks(THREAD_POOL* pool, int index) {
+    TASK_RANGE range;
+
+    for (;;) {
+        int found = pop_bottom(&pool->deques[index], &range);
+        for (int i = 1; !found && i < pool->num_threads; i++)
+            found = steal_top(&pool->deques[(index + i) % pool->num_threads], &range);
+        if (!found)
+            return;
+        pool->function(pool->context, range.begin, range.end, index);
+    }
+}
+
+static int worker_main(void* data) {
+    WORKER* worker = (WORKER*)data;
+    THREAD_POOL* pool = worker->pool;
+    int generation = 0;
+
+    for (;;) {
+        SDL_LockMutex(pool->mutex);
+        while (!pool->quit && pool->generation == generation)
+            SDL_CondWait(pool->start, pool->mutex);
+        if (pool->quit) {
+            SDL_UnlockMutex(pool->mutex);
+            return 0;
+        }
+        generation = pool->generation;
+        SDL_UnlockMutex(pool->mutex);
+
+        run_tasks(pool, worker->index);
+
+        SDL_LockMutex(pool->mutex);
+        if (--pool->busy == 0)
+            SDL_CondSignal(pool->finished);
+        SDL_UnlockMutex(pool->mutex);
+    }
+}
+
+// threads that fail to start are left out, down to running everything on the caller
+void create_thread_pool(THREAD_POOL* pool, int num_threads) {
+    memset(pool, 0, sizeof(THREAD_POOL));
+    if (num_threads > THREAD_POOL_MAX_THREADS)
+        num_threads = THREAD_POOL_MAX_THREADS;
+    pool->mutex = SDL_CreateMutex();
+    pool->start = SDL_CreateCond();
+    pool->finished = SDL_CreateCond();
+    pool->num_threads = 1;
+
+    for (int i = 1; i < num_threads; i++) {
+        WORKER* worker = &pool->workers[pool->num_threads];
+        worker->pool = pool;
+        worker->index = pool->num_threads;
+        worker->thread = SDL_CreateThread(worker_main, "worker", worker);
+        if (worker->thread == NULL) {
+            DBG_PRINT("Error creating worker thread: %s\n", SDL_GetError());
+            break;
+        }
+        pool->num_threads++;
+    }
+}
+
+// splits the items into chunks, hands each worker a contiguous run of them and works through them
+// on every thread until none are left
+void thread_pool_run(THREAD_POOL* pool, TASK_FUNCTION function, void* context, int num_items, int chunk_size) {
+    int num_chunks;
+
+    if (num_items <= 0)
+        return;
+    if (chunk_size < 1)
+        chunk_size = 1;
+    // coarser chunks when there are more than the deques hold
+    if (num_items > chunk_size * pool->num_threads * THREAD_POOL_DEQUE_SIZE)
+        chunk_size = (num_items + pool->num_threads * THREAD_POOL_DEQUE_SIZE - 1) / (pool->num_threads * THREAD_POOL_DEQUE_SIZE);
+    num_chunks = (num_items + chunk_size - 1) / chunk_size;
+    // not worth waking anyone for
+    if (num_chunks == 1 || pool->num_threads == 1) {
+        function(context, 0, num_items, 0);
+        return;
+    }
+
+    for (int w = 0; w < pool->num_threads; w++) {
+        WORK_DEQUE* deque = &pool->deques[w];
+        int first = (int)((long long)num_chunks * w / pool->num_threads);
+        int last = (int)((long long)num_chunks * (w + 1) / pool->num_threads);
+        deque->top = 0;
+        deque->bottom = 0;
+        // pushed back to front, so the owner pops its chunks in item order
+        for (int c = last - 1; c >= first; c--) {
+            TASK_RANGE* range = &deque->ranges[deque->bottom++];
+            range->begin = c * chunk_size;
+            range->end = (c + 1) * chunk_size < num_items ? (c + 1) * chunk_size : num_items;
+        }
+    }
+
+    SDL_LockMutex(pool->mutex);
+    pool->function = function;
+    pool->context = context;
+    pool->busy = pool->num_threads - 1;
+    pool->generation++;
+    SDL_CondBroadcast(pool->start);
+    SDL_UnlockMutex(pool->mutex);
+
+    run_tasks(pool, 0);
+
+    SDL_LockMutex(pool->mutex);
+    while (pool->busy > 0)
+        SDL_CondWait(pool->finished, pool->mutex);
+    SDL_UnlockMutex(pool->mutex);
+}
+
+void delete_thread_pool(THREAD_POOL* pool) {
+    SDL_LockMutex(pool->mutex);
+    pool->quit = 1;
+    SDL_CondBroadcast(pool->start);
+    SDL_UnlockMutex(pool->mutex);
+
+    for (int i = 1; i < pool->num_threads; i++)
+        SDL_WaitThread(pool->workers[i].thread, NULL);
+    SDL_DestroyCond(pool->finished);
+    SDL_DestroyCond(pool->start);
+    SDL_DestroyMutex(pool->mutex);
+    memset(pool, 0, sizeof(THREAD_POOL));
+}
@@ -0,0 +1,54 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include "SDL2/SDL.h"
+
+#define THREAD_POOL_MAX_THREADS 16
+#define THREAD_POOL_DEQUE_SIZE 256 // chunks a worker can be handed per run
+
+// items [begin, end) of a run, on the given thread of the pool, 0 being the caller
+typedef void (*TASK_FUNCTION)(void* context, int begin, int end, int thread);
+
+typedef struct {
+    int begin;
+    int end;
+} TASK_RANGE;
+
+// the owner pops chunks from the bottom, idle workers steal from the top. runs never add work,
+// so a spinlock per deque is held only for an index bump and is rarely contended
+typedef struct {
+    SDL_SpinLock lock;
+    int top;
+    int bottom;
+    TASK_RANGE ranges[THREAD_POOL_DEQUE_SIZE];
+} WORK_DEQUE;
+
+struct THREAD_POOL;
+
+typedef struct {
+    struct THREAD_POOL* pool;
+    int index;
+    SDL_Thread* thread;
+} WORKER;
+
+// persistent workers parked on a condition variable between runs. the calling thread joins in as
+// worker 0 and thread_pool_run returns once every chunk is done
+typedef struct THREAD_POOL {
+    WORKER workers[THREAD_POOL_MAX_THREADS];
+    WORK_DEQUE deques[THREAD_POOL_MAX_THREADS];
+    int num_threads; // including the caller
+    SDL_mutex* mutex;
+    SDL_cond* start;
+    SDL_cond* finished;
+    int generation; // bumped for every run, workers wake up when it changes
+    int busy; // workers still on the current run
+    int quit;
+    TASK_FUNCTION function;
+    void* context;
+} THREAD_POOL;
+
+void create_thread_pool(THREAD_POOL* pool, int num_threads);
+void thread_pool_run(THREAD_POOL* pool, TASK_FUNCTION function, void* context, int num_items, int chunk_size);
+void delete_thread_pool(THREAD_POOL* pool);
+
+#endif  // THREADPOOL_H
@@ -7,9 +7,7 @@
 #define ARRAY_SIZE(arr) (sizeof(arr)/sizeof(*(arr)))
 #define ALIGN_32(value) (((value) + 31) & ~31)
 
-#ifdef ENABLE_PROFILING
 long long current_microseconds();
-#endif
 
 #ifdef ENABLE_DBG
 #define DBG_PRINT(str, ...) \
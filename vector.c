@@ -1,94 +1,60 @@
 #include <stdio.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 #include "vector.h"
 #include "utils.h"
 #include <time.h>
-int g_id;
-#ifdef ENABLE_OPENCL
-extern cl_context g_context;
-#endif
 
-void create_polygon(POLYGON* polygon, int num_vertices){
-    polygon->vertices = (VECTOR*)malloc(num_vertices * sizeof(VECTOR));
-    
+// the vertices come from the arena and go back with it on arena_reset, there is nothing to free per polygon
+void create_polygon(POLYGON* polygon, ARENA* arena, int num_vertices){
+    polygon->vertices = (VECTOR*)arena_alloc(arena, num_vertices * sizeof(VECTOR));
+    polygon->vertices_capacity = num_vertices;
     polygon->vertices_idx = 0;
-    polygon->velocity.x = 0.0;
-    polygon->velocity.y = 0.0;
-    polygon->next = NULL;
-    polygon->id = g_id++;
-#ifdef ENABLE_OPENCL
-    int status = 0;
-    polygon->object_buffer = clCreateBuffer(g_context, CL_MEM_ALLOC_HOST_PTR | CL_MEM_READ_ONLY, sizeof(VECTOR) * MAX_VERTICES, NULL, &status);
-    if (status != CL_SUCCESS)
-        printf("Error creating buffer: %d\n", status);
-#endif
-}
-
-void create_polygon_list(POLYGON_LIST* list){
-    list = (POLYGON_LIST*)malloc(sizeof(POLYGON_LIST));
-    list->head = NULL;
-}
-
-void add_polygon_to_list(POLYGON_LIST* list, POLYGON* polygon){
-    polygon->next = list->head;
-    list->head = polygon;
-}
-
-void delete_all_polygons(POLYGON_LIST* list) {
-    POLYGON* current = list->head;
-    while (current != NULL) {
-        POLYGON* next = current->next;
-        delete_polygon(list, current);
-        current = next;
-    }
-    list->head = NULL;
-    g_id = 0;
+    memset(&polygon->aabb, 0, sizeof(AABB));
+    polygon->type = SHAPE_POLYGON;
 }
 
 void add_vertice(POLYGON* polygon, double x, double y){
-
-    if(polygon->vertices_idx % 4 == 0)
-        polygon->vertices = (VECTOR*)realloc(polygon->vertices, (polygon->vertices_idx + 4) * sizeof(VECTOR));
+    if(polygon->vertices_idx == polygon->vertices_capacity) {
+        DBG_PRINT("add_vertice: polygon is full at %d vertices\n", (int)polygon->vertices_capacity);
+        return;
+    }
 
     polygon->vertices[polygon->vertices_idx].x = x;
     polygon->vertices[polygon->vertices_idx].y = y;
     polygon->vertices_idx++;
 
-}
-
-void set_velocity_x(POLYGON* polygon, double val){
-    polygon->velocity.x = val;
-}
+    VECTOR vertice = polygon->vertices[polygon->vertices_idx - 1];
+    if(polygon->vertices_idx == 1) {
+        polygon->aabb.min = vertice;
+        polygon->aabb.max = vertice;
+    } else {
+        polygon->aabb.min.x = fmin(polygon->aabb.min.x, vertice.x);
+        polygon->aabb.min.y = fmin(polygon->aabb.min.y, vertice.y);
+        polygon->aabb.max.x = fmax(polygon->aabb.max.x, vertice.x);
+        polygon->aabb.max.y = fmax(polygon->aabb.max.y, vertice.y);
+    }
 
-void set_velocity_y(POLYGON* polygon, double val){
-    polygon->velocity.y = val;
 }
 
-void delete_polygon(POLYGON_LIST* list, POLYGON* polygon){
-    POLYGON* current = list->head;
-    POLYGON* prev = NULL;
-    while (current != NULL && current->id != polygon->id) {
-        prev = current;
-        current = current->next;
+void translate_polygon(POLYGON* polygon, int dx, int dy){
+    for(int i = 0; i < polygon->vertices_idx; i++) {
+        polygon->vertices[i].x += dx;
+        polygon->vertices[i].y += dy;
     }
-
-    if(current->id == polygon->id){
-        if(prev != NULL)
-            prev->next = current->next;
-        else
-            list->head = current->next;
-    }
-    memset(&polygon, 0, sizeof(polygon));
-    free(polygon);
+    polygon->center.x += dx;
+    polygon->center.y += dy;
+    polygon->aabb.min.x += dx;
+    polygon->aabb.min.y += dy;
+    polygon->aabb.max.x += dx;
+    polygon->aabb.max.y += dy;
 }
 
-void create_circle(POLYGON* polygon, double center_x, double center_y, double radius, int polygon_count) {
+void create_circle(POLYGON* polygon, ARENA* arena, double center_x, double center_y, double radius, int polygon_count) {
     const double increments = 2 * PI / polygon_count;
 
-    create_polygon(polygon, polygon_count);
-    set_velocity_x(polygon, 0);
-    set_velocity_y(polygon, 0);
+    create_polygon(polygon, arena, polygon_count);
 
     for (int i = 0; i < polygon_count; i++) {
         double angle = i * increments;
@@ -96,6 +62,26 @@ void create_circle(POLYGON* polygon, double center_x, double center_y, double ra
         double y = center_y + radius * sin(angle);
         add_vertice(polygon, x, y);
     }
+
+    polygon->type = SHAPE_CIRCLE;
+    polygon->center.x = center_x;
+    polygon->center.y = center_y;
+    polygon->radius = radius;
+}
+
+void create_box(POLYGON* polygon, ARENA* arena, int x, int y, int width, int height) {
+    create_polygon(polygon, arena, 4);
+
+    add_vertice(polygon, x, y); // top left
+    add_vertice(polygon, x, y + height); // bottom left
+    add_vertice(polygon, x + width, y + height); // bottom right
+    add_vertice(polygon, x + width, y); // top right
+
+    polygon->type = SHAPE_BOX;
+    polygon->center.x = x + width / 2;
+    polygon->center.y = y + height / 2;
+    polygon->half_extents.x = width / 2;
+    polygon->half_extents.y = height / 2;
 }
 
 double cross_multiply(VECTOR v1, VECTOR v2){
@@ -106,7 +92,21 @@ double dot_multiply(VECTOR v1, VECTOR v2){
     return v1.x * v2.x + v1.y * v2.y;
 }
 
-void calculate_minkowski_diff(VECTOR set1[], int set1_size, VECTOR set2[], int set2_size, VECTOR result[]) {
+static int polygon_orientation(VECTOR set[], int set_size) {
+    double area = 0.0;
+    for (int i = 0; i < set_size; i++)
+        area += cross_multiply(set[i], set[(i + 1) % set_size]);
+    return (area < 0) ? -1 : 1;
+}
+
+// index of the k'th vertex when walking the polygon with positive orientation from start
+static int walk_index(int start, int k, int direction, int set_size) {
+    return ((start + direction * k) % set_size + set_size) % set_size;
+}
+
+// merges the edges of set1 and -set2 by angle, producing the ordered convex hull of set1 - (set2 + offset).
+// result needs room for set1_size + set2_size vertices, the number of hull vertices is returned
+int calculate_minkowski_diff(VECTOR set1[], int set1_size, VECTOR set2[], int set2_size, VECTOR offset, VECTOR result[]) {
 #ifdef ENABLE_PROFILING
     // //START TRACKING HERE
     long long start_time, end_time;
@@ -114,12 +114,44 @@ void calculate_minkowski_diff(VECTOR set1[], int set1_size, VECTOR set2[], int s
     start_time = current_microseconds();
 #endif
     int vertice = 0;
+    int dir1 = polygon_orientation(set1, set1_size);
+    int dir2 = polygon_orientation(set2, set2_size);
+    int start1 = 0, start2 = 0;
+
+    // start set1 at its lowest point and -set2 at its lowest point (the highest point of set2)
+    for (int i = 1; i < set1_size; i++) {
+        if (set1[i].y < set1[start1].y || (set1[i].y == set1[start1].y && set1[i].x < set1[start1].x))
+            start1 = i;
+    }
+    for (int j = 1; j < set2_size; j++) {
+        if (set2[j].y > set2[start2].y || (set2[j].y == set2[start2].y && set2[j].x > set2[start2].x))
+            start2 = j;
+    }
 
-    for (int i = 0; i < set1_size; i++) {
-        for (int j = 0; j < set2_size; j++) {
-            result[vertice].x = set1[i].x - set2[j].x;
-            result[vertice].y = set1[i].y - set2[j].y;
-            vertice++;
+    int i = 0, j = 0;
+    while (i < set1_size || j < set2_size) {
+        VECTOR p1 = set1[walk_index(start1, i, dir1, set1_size)];
+        VECTOR p2 = set1[walk_index(start1, i + 1, dir1, set1_size)];
+        VECTOR q1 = set2[walk_index(start2, j, dir2, set2_size)];
+        VECTOR q2 = set2[walk_index(start2, j + 1, dir2, set2_size)];
+
+        result[vertice].x = p1.x - q1.x - offset.x;
+        result[vertice].y = p1.y - q1.y - offset.y;
+        vertice++;
+
+        if (i == set1_size) {
+            j++;
+        } else if (j == set2_size) {
+            i++;
+        } else {
+            // edge of -set2 is q1 -> q2 negated
+            VECTOR edge1 = {p2.x - p1.x, p2.y - p1.y};
+            VECTOR edge2 = {q1.x - q2.x, q1.y - q2.y};
+            double cross = cross_multiply(edge1, edge2);
+            if (cross >= 0)
+                i++;
+            if (cross <= 0)
+                j++;
         }
     }
 #ifdef ENABLE_PROFILING
@@ -127,33 +159,5 @@ void calculate_minkowski_diff(VECTOR set1[], int set1_size, VECTOR set2[], int s
     time = (end_time-start_time);
     printf("elapsed time of minkowski_diff : %.4f us\n", time);
 #endif
-}
-
-int is_polygon_id_in_arr(int* arr, int size, int polygon_id) {
-    for(int i = 0; i < size; i++) {
-        if(arr[i] == polygon_id)
-            return true;
-    }
-    return false;
-}
-
-void convert_list_to_arr(POLYGON* head, POLYGON*** p_arr, int* p_no_polygons){ // take in a pointer to polygon array
-    int polygon_count = 0;
-    POLYGON* current = head;
-
-    while(current != NULL){
-        current = current->next;
-        polygon_count++;
-    }
-
-    *p_no_polygons = polygon_count;
-    *p_arr = (POLYGON**)malloc(polygon_count * sizeof(POLYGON*)); // dereference (take value aka pointer to pointer of array, and allocate space for array)
-
-    current = head;
-    for(int i=0; i < polygon_count; i++) {
-        if(current != NULL)
-            (*p_arr)[i] = current; // set pointer of arr[i] to current polygon
-        current = current->next;
-    }
-
+    return vertice;
 }
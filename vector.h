@@ -3,11 +3,10 @@
 
 #include <stdbool.h>
 #include "SDL2/SDL.h"
-#ifdef ENABLE_OPENCL
-#include "CL/cl.h"
-#endif
+#include "arena.h"
 #define PI 3.14159265358979323846
 #define MAX_VERTICES 30 // change this if we use more vertices in any one polygon
+#define MAX_MINKOWSKI_VERTICES (MAX_VERTICES*2) // convex minkowski difference has at most n+m vertices
 
 // 16 bytes per vertice
 typedef struct {
@@ -15,37 +14,43 @@ typedef struct {
     int y;
 } VECTOR;
 
-//up to 30 vertices per polygon, so max 480 bytes per polygon. two polygons sent to kernel per iteration, so 960 bytes input to kernel
 typedef struct {
-    int id;
-    VECTOR* vertices;
+    VECTOR min;
+    VECTOR max;
+} AABB;
+
+// circles and boxes carry their exact geometry for collision detection, their vertices are only used for drawing
+typedef enum {
+    SHAPE_CIRCLE,
+    SHAPE_BOX,
+    SHAPE_POLYGON,
+    SHAPE_TYPE_COUNT
+} SHAPE_TYPE;
+
+// a shape in local space around its center. bodies share shapes and only add a position, so a
+// shape is built once by create_circle or create_box and never modified afterwards
+typedef struct {
+    VECTOR* vertices; // owned by the arena the shape was created from
     size_t vertices_idx;
-    VECTOR velocity;
+    size_t vertices_capacity;
+    AABB aabb; // kept in step with the vertices by add_vertice and translate_polygon
+    SHAPE_TYPE type;
+    VECTOR center; // circle and box only
+    int radius; // circle only
+    VECTOR half_extents; // box only
 #ifdef ENABLE_OPENCL
-    cl_mem object_buffer;
+    int device_offset; // first vertex in the packed shape buffer on the device
 #endif
-    struct POLYGON* next;
 } POLYGON;
 
-// for resulting minkowski difference vector set, 900 vertices maximum so 900*16 = 14400 bytes output from kernel
-typedef struct {
-    POLYGON* head;
-} POLYGON_LIST;
 
-void create_polygon(POLYGON* polygon, int initial_size);
-void create_polygon_list(POLYGON_LIST* list);
-void add_polygon_to_list(POLYGON_LIST* list, POLYGON* polygon);
+void create_polygon(POLYGON* polygon, ARENA* arena, int num_vertices);
 void add_vertice(POLYGON* polygon, double x, double y);
-void set_velocity_x(POLYGON* polygon, double val);
-void set_velocity_y(POLYGON* polygon, double val);
-void delete_polygon(POLYGON_LIST* list, POLYGON* polygon);
-void create_circle(POLYGON* polygon, double center_x, double center_y, double radius, int polygon_count);
+void translate_polygon(POLYGON* polygon, int dx, int dy);
+void create_circle(POLYGON* polygon, ARENA* arena, double center_x, double center_y, double radius, int polygon_count);
+void create_box(POLYGON* polygon, ARENA* arena, int x, int y, int width, int height);
 double cross_multiply(VECTOR v1, VECTOR v2);
 double dot_multiply(VECTOR v1, VECTOR v2);
-void calculate_minkowski_diff(VECTOR set1[], int set1_size, VECTOR set2[], int set2_size, VECTOR result[]);
-void delete_all_polygons(POLYGON_LIST* polygon_list);
-void print_polygon_list_details(POLYGON_LIST* polygon_list);
-int is_polygon_id_in_arr(int* arr, int size, int polygon_id);
-void convert_list_to_arr(POLYGON* head, POLYGON*** p_arr, int* p_no_polygons);
+int calculate_minkowski_diff(VECTOR set1[], int set1_size, VECTOR set2[], int set2_size, VECTOR offset, VECTOR result[]);
 
 #endif  // VECTOR_H